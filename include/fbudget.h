@@ -0,0 +1,57 @@
+#pragma once
+#include "fctx.h"
+
+// -----------------------------------------------------------------------------
+// Frame budget.
+//
+// Measures the time taken to render each frame of an animation against a
+// budget, and lowers the drawing quality of the following frames while they
+// run over it: first curves are flattened more coarsely, then moving elements
+// are drawn in BW mode, then everything is.  Full quality comes back with the
+// first frame drawn while the face is idle.  The quality is applied through
+// the defaults for new contexts (fctx_enable_aa and
+// fctx_enable_coarse_curves), so the face should initialize its contexts
+// between fbudget_begin_frame and fbudget_end_frame.
+// -----------------------------------------------------------------------------
+
+typedef enum {
+    FQualityFull = 0,
+    FQualityCoarseCurves,
+    FQualityBWMoving,
+    FQualityBW
+} FQuality;
+
+typedef uint32_t (*fbudget_clock_func)(void);
+
+typedef struct FFrameBudget {
+    uint32_t budget;            /* milliseconds per frame */
+    uint32_t frame_start;
+    uint32_t frame_time;        /* the time taken by the last frame */
+    FQuality quality;
+    bool aa;                    /* the default mode when the budget was initialized */
+    fbudget_clock_func clock;   /* milliseconds; based on time_ms by default */
+} FFrameBudget;
+
+/**
+ * Start at full quality, with the current default mode as the best one.
+ */
+void fbudget_init(FFrameBudget* budget, uint32_t budget_ms);
+
+/**
+ * Call at the start of each frame, before its contexts are initialized, to
+ * select the default mode and curve flattening for the frame.
+ */
+void fbudget_begin_frame(FFrameBudget* budget);
+
+/**
+ * Call at the end of each frame.  A frame over budget lowers the quality of
+ * the next one by a step while animating is set; a frame drawn with it clear
+ * restores full quality for the next one.
+ */
+void fbudget_end_frame(FFrameBudget* budget, bool animating);
+
+/**
+ * The mode for a context that draws moving elements, such as a second hand,
+ * when moving is set, or static ones otherwise.
+ */
+FContextMode fbudget_mode(FFrameBudget* budget, bool moving);
@@ -12,15 +12,37 @@ bool checkObject(void* obj, const char* objname);
 typedef int32_t fixed_t;
 struct FFont;
 typedef struct FFont FFont;
+struct FPaint;
+typedef struct FPaint FPaint;
 
-// Defines the fixed point conversions
+// Defines the fixed point conversions.  A host build may define a larger
+// FIXED_POINT_SHIFT for finer coordinates; compiled paths and fonts are stored
+// at a scale of 16 and converted as they are read.
+#ifndef FIXED_POINT_SHIFT
 #define FIXED_POINT_SHIFT 4
-#define FIXED_POINT_SCALE 16
+#endif
+#if FIXED_POINT_SHIFT < 4
+#error "FIXED_POINT_SHIFT must be at least 4"
+#endif
+#define FIXED_POINT_SCALE (1 << FIXED_POINT_SHIFT)
 #define INT_TO_FIXED(a) ((a) * FIXED_POINT_SCALE)
 #define FIXED_TO_INT(a) ((a) / FIXED_POINT_SCALE)
 #define FIXED_MULTIPLY(a, b) (((a) * (b)) / FIXED_POINT_SCALE)
 #define FIX1 FIXED_POINT_SCALE
 
+/*
+ * Intermediate products in the edge setup and the transforms, such as a
+ * coordinate times a scale or a sine, fit 32 bits at watch sizes.  Define
+ * FCTX_WIDE_MATH to compute them in 64 bits for large canvases, large scales
+ * or a larger FIXED_POINT_SHIFT.  The results are the same wherever the
+ * 32-bit products do not overflow.
+ */
+#ifdef FCTX_WIDE_MATH
+typedef int64_t fixed_wide_t;
+#else
+typedef int32_t fixed_wide_t;
+#endif
+
 typedef struct FPoint {
     fixed_t x;
     fixed_t y;
@@ -30,10 +52,58 @@ typedef struct FPoint {
 #define FPointZero FPoint(0, 0)
 #define FPointOne FPoint(1, 1)
 
+/*
+ * Optional rasterizer instrumentation.  Define FCTX_STATS when building the
+ * library to count the work done by each context.  Times are in microseconds,
+ * as measured by the stats clock.
+ */
+#ifdef FCTX_STATS
+typedef struct FContextStats {
+    uint32_t fills;
+    uint32_t edges_plotted;
+    uint32_t dda_steps;           /* steps that landed on a flag buffer row */
+    uint32_t dda_steps_skipped;   /* steps above the top of the flag buffer */
+    uint32_t dda_steps_wasted;    /* steps right of the flag buffer */
+    uint32_t bezier_segments;
+    uint32_t rows_scanned;
+    uint32_t pixels_scanned;
+    uint32_t pixels_blended;
+    uint32_t pixels_solid;
+    uint32_t pixels_occluded;     /* pixels skipped under earlier fills */
+    uint32_t framebuffer_captures;
+    uint32_t plot_time;
+    uint32_t resolve_time;
+    uint32_t phase_start;
+} FContextStats;
+
+typedef uint32_t (*fctx_clock_func)(void);
+#endif
+
+/*
+ * The rendering mode of a context is chosen when it is initialized, and is
+ * fixed for the lifetime of the context.  Contexts in different modes may be
+ * live at the same time.
+ */
+typedef enum {
+    FContextModeBW = 0,
+    FContextModeAA
+} FContextMode;
+
+struct FContextOps;
+struct FBandState;
+struct FOcclusion;
+
 typedef struct FContext {
+    const struct FContextOps* ops;
+    FContextMode mode;
+    bool coarse_curves;
     GContext* gctx;
+    GBitmap* target;
     GBitmap* flag_buffer;
     GRect flag_bounds;
+    int16_t band_top;
+    struct FBandState* bands;
+    struct FOcclusion* occlusion;
     FPoint extent_min;
     FPoint extent_max;
     FPoint path_cur_point;
@@ -42,26 +112,202 @@ typedef struct FContext {
     FPoint transform_scale_to;
     fixed_t subpixel_adjust;
     GColor fill_color;
+    const FPaint* fill_paint;
+#ifdef FCTX_STATS
+    FContextStats stats;
+#endif
 } FContext;
 
+#ifdef FCTX_STATS
+#define FCTX_STAT(fctx, field, n) ((fctx)->stats.field += (n))
+void fctx_reset_stats(FContext* fctx);
+void fctx_set_stats_clock(fctx_clock_func clock);
+uint32_t fctx_stats_clock();
+#else
+#define FCTX_STAT(fctx, field, n)
+#endif
+
 void fctx_set_fill_color(FContext* fctx, GColor c);
+
+/**
+ * Fill with a paint (see fpaint.h) instead of a solid color, until the next
+ * call to fctx_set_fill_color.  The paint must outlive the fills that use it.
+ */
+void fctx_set_fill_paint(FContext* fctx, const FPaint* paint);
 void fctx_set_offset(FContext* fctx, FPoint offset);
 
 void fctx_transform_points(FContext* fctx, uint16_t pcount, FPoint* ppoints, FPoint* tpoints, FPoint advance);
 
-typedef void (*fctx_init_context_func)(FContext* fctx, GContext* gctx);
 typedef void (*fctx_plot_edge_func)(FContext* fctx, FPoint* a, FPoint* b);
 typedef void (*fctx_end_fill_func)(FContext* fctx);
 
-extern fctx_init_context_func fctx_init_context;
-extern void fctx_begin_fill(FContext* fctx);
-extern fctx_plot_edge_func fctx_plot_edge;
-extern fctx_end_fill_func fctx_end_fill;
-extern void fctx_deinit_context(FContext* fctx);
+typedef struct FContextOps {
+    fctx_plot_edge_func plot_edge;
+    fctx_end_fill_func end_fill;
+} FContextOps;
+
+/**
+ * Initialize a context in the default mode, as selected by fctx_enable_aa.
+ * @return false if the flag buffer could not be allocated.  The context is
+ * still safe to draw with and to deinit, but draws nothing.
+ */
+bool fctx_init_context(FContext* fctx, GContext* gctx);
+bool fctx_init_context_mode(FContext* fctx, GContext* gctx, FContextMode mode);
+
+/**
+ * Initialize a context that draws into a caller-owned bitmap instead of the
+ * frame buffer.  The bitmap must be in the frame buffer format, and must
+ * outlive the context.  On color platforms, fills are composited over the
+ * bitmap using its alpha channel, so a bitmap cleared to GColorClear can be
+ * drawn as a layer with fctx_draw_layer.
+ */
+bool fctx_init_context_bitmap(FContext* fctx, GBitmap* target, FContextMode mode);
+
+/**
+ * Initialize a context whose flag buffer covers only band_height rows of the
+ * frame buffer.  The edges of each fill are recorded, and plotted and
+ * resolved one band at a time by fctx_end_fill.  The result is identical to
+ * an unbanded context; the cost is time, which grows with the number of
+ * bands.  A band_height of 0, or of the frame buffer height or more, gives
+ * an unbanded context.
+ */
+bool fctx_init_context_banded(FContext* fctx, GContext* gctx, FContextMode mode, int16_t band_height);
+
+/**
+ * An estimate of the heap bytes allocated by a context in the given mode and
+ * band height, for the frame buffer of gctx or for a target bitmap.  This
+ * counts the flag buffer pixels, with an allowance for its GBitmap object and
+ * the heap block headers, and for a banded context the initial edge list.
+ * For a banded context it is a lower bound: the edge list grows for fills
+ * with more than FCTX_BAND_EDGE_RESERVE points.
+ */
+#define FCTX_BAND_EDGE_RESERVE 128
+size_t fctx_memory_required(GContext* gctx, FContextMode mode, int16_t band_height);
+size_t fctx_memory_required_bitmap(GBitmap* target, FContextMode mode, int16_t band_height);
+
+/**
+ * Initialize a context in the best configuration that leaves at least
+ * reserve bytes of heap free: the default mode unbanded, then in bands of
+ * half, a quarter, an eighth (and so on, down to FCTX_MIN_BAND_HEIGHT rows)
+ * of the frame buffer, then the same for BW mode.
+ * @return false if no configuration fits; the context then draws nothing.
+ */
+#define FCTX_MIN_BAND_HEIGHT 8
+
+/**
+ * The band height of an AA context on a 1-bit platform when none is given.
+ * Its flag buffer has a byte per pixel, so it is always banded there.
+ */
+#define FCTX_DITHER_BAND_HEIGHT 16
+bool fctx_init_context_auto(FContext* fctx, GContext* gctx, size_t reserve);
+
+/**
+ * Get the bitmap that the context draws into: its target bitmap, or the
+ * captured frame buffer.  Each call must be paired with fctx_release_target.
+ */
+GBitmap* fctx_capture_target(FContext* fctx);
+void fctx_release_target(FContext* fctx, GBitmap* target);
+
+/**
+ * Composite a layer rendered by fctx_init_context_bitmap onto the context's
+ * target, with its top left corner at origin.  On color platforms, clear
+ * pixels are skipped, opaque pixels are copied and the rest are blended by
+ * their alpha.  On BW platforms, the layer is copied.
+ */
+void fctx_draw_layer(FContext* fctx, GBitmap* layer, GPoint origin);
 
 #ifdef PBL_COLOR
+/**
+ * Composite a color with coverage a (in eighths) over a pixel, accounting for
+ * the alpha of both.  Over an opaque pixel, an opaque color gives the same
+ * result as the blend used by fctx_end_fill.
+ */
+uint8_t fctx_blend_over(uint8_t dest, GColor8 s, uint8_t a);
+#endif
+void fctx_begin_fill(FContext* fctx);
+void fctx_plot_edge(FContext* fctx, FPoint* a, FPoint* b);
+void fctx_end_fill(FContext* fctx);
+
+/**
+ * Fill the rectangle with corners min and max, given like path points and
+ * drawn through the current transform, with the fill color or paint.  This is
+ * a complete fill, so call it outside of fctx_begin_fill / fctx_end_fill.  The
+ * result is the same as filling the four corners as a path, but an AA fill
+ * with a solid color resolves its edge rows directly and its interior as
+ * solid spans, without touching the flag buffer.
+ */
+void fctx_fill_rect(FContext* fctx, FPoint min, FPoint max);
+
+/**
+ * Draw the following fills front to back, until fctx_end_occlusion: each fill
+ * goes behind the fills before it.  Pixels that earlier fills cover fully are
+ * skipped, and edge pixels receive only the coverage that is left.  The target
+ * must already be cleared to the background color, which is what the edges of
+ * the frontmost fills are blended toward.  A fill that is a complete
+ * background, such as a full-screen dial, can then be drawn last.
+ * @return false if the coverage mask cannot be allocated, the context draws
+ * into a layer with alpha, or it dithers AA fills on a 1-bit platform; the
+ * context then keeps drawing back to front.
+ */
+bool fctx_begin_occlusion(FContext* fctx, GColor background);
+void fctx_end_occlusion(FContext* fctx);
+void fctx_deinit_context(FContext* fctx);
+
+/**
+ * Select the mode used by fctx_init_context.  Contexts that are already
+ * initialized keep their mode.  The default is AA on color platforms and BW
+ * on 1-bit platforms, where AA fills are ordered-dithered to black and white.
+ */
 void fctx_enable_aa(bool enable);
 bool fctx_is_aa_enabled();
+
+/**
+ * Flatten each curve into two chords, through its midpoint, instead of five
+ * in the contexts initialized afterwards.  This saves plotting time at the
+ * cost of visibly rougher curves, for frames that are over budget (see
+ * fbudget.h).  Paths flattened with fctx_flatten_commands keep the chords
+ * they were flattened with.
+ */
+void fctx_enable_coarse_curves(bool enable);
+bool fctx_is_coarse_curves_enabled();
+
+#ifdef PBL_COLOR
+
+/**
+ * Initialize an AA context that rasterizes into a coverage mask of the given
+ * size instead of a GContext.  Finish each shape with fctx_end_fill_mask,
+ * which writes one 4-bit coverage value (0 to 8) per pixel, two pixels per
+ * byte with the left pixel in the low nibble.
+ */
+bool fctx_init_mask_context(FContext* fctx, GSize size);
+void fctx_end_fill_mask(FContext* fctx, uint8_t* mask, uint16_t stride);
+#endif
+
+#if defined(FCTX_HOST) && defined(PBL_COLOR)
+/*
+ * Host builds resolve solid AA fills with vector kernels (SSE2, AVX2 or NEON)
+ * where the CPU has them.  Each kernel gives the same pixels as the scalar
+ * one.  Builds with FCTX_STATS always use the scalar loop, which counts the
+ * pixels it blends.
+ */
+typedef void (*fctx_resolve_span_func)(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 color);
+void fctx_resolve_span(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 color);
+void fctx_resolve_span_scalar(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 color);
+
+/**
+ * Select a kernel by name ("scalar", "sse2", "avx2" or "neon").  By default
+ * the widest supported kernel is used, or the one named by the FCTX_KERNEL
+ * environment variable.
+ * @return false if the kernel is not available on this CPU.
+ */
+bool fctx_host_select_kernel(const char* name);
+const char* fctx_host_kernel_name(void);
+
+/**
+ * Check every supported kernel against the scalar kernel on random spans.
+ * @return the number of spans that differ.
+ */
+int fctx_host_self_test(uint32_t iterations);
 #endif
 
 // -----------------------------------------------------------------------------
@@ -69,13 +315,90 @@ bool fctx_is_aa_enabled();
 // -----------------------------------------------------------------------------
 
 typedef int16_t fixed16_t;
+#define FIXED16_TO_FIXED(a) ((fixed_t)(a) * (FIXED_POINT_SCALE >> 4))
+#define FIXED_TO_FIXED16(a) ((fixed16_t)((a) / (FIXED_POINT_SCALE >> 4)))
 typedef struct __attribute__((__packed__)) FPathDrawCommand {
 	uint16_t code;
 	fixed16_t params[];
 } FPathDrawCommand;
 
+/*
+ * Packed path data, about half the size of FPathDrawCommand streams.  It
+ * starts with FCTX_PACKED_PATH_MAGIC, which no command code starts with, so
+ * the two formats can be passed to the same functions.  Each command is one
+ * byte: the index of its code in FCTX_PACKED_PATH_CODES in the low nibble,
+ * and the number of times it repeats, less one, in the high nibble.  Each
+ * parameter is the difference from the previous coordinate on its axis,
+ * zigzag encoded in groups of 7 bits, low group first, with the top bit set
+ * on every byte but the last.  The previous coordinate at the start of a
+ * command is the current point, which 'Z' returns to the subpath start.
+ */
+#define FCTX_PACKED_PATH_MAGIC 0xFC
+#define FCTX_PACKED_PATH_CODES "MZLHVCSQT"
+#define FCTX_PACKED_PATH_MAX_REPEAT 16
+
+/*
+ * Reads the commands of either format, one at a time, without a buffer.
+ */
+typedef struct FPathCursor {
+    const uint8_t* data;
+    const uint8_t* end;
+    bool packed;
+    char code;
+    uint8_t repeat;
+    fixed16_t x;
+    fixed16_t y;
+    fixed16_t init_x;
+    fixed16_t init_y;
+} FPathCursor;
+
+void fctx_path_cursor_init(FPathCursor* cursor, const void* path_data, uint16_t length);
+
+/**
+ * Read the next command.
+ * @param params receives the parameters of the command as absolute
+ * coordinates, in the order of FPathDrawCommand: at most 6.
+ * @return the command code, or 0 at the end of the data or at an invalid
+ * command.
+ */
+char fctx_path_cursor_next(FPathCursor* cursor, fixed16_t* params);
+
+/**
+ * Check that path data of either format holds only whole, valid commands,
+ * so that reading it never runs past its end.  The cursor and the draw
+ * functions trust their input; validate data from untrusted files first.
+ */
+bool fctx_path_validate(const void* path_data, uint16_t length);
+
 void fctx_draw_commands(FContext* fctx, FPoint advance, void* path_data, uint16_t length);
 
+// -----------------------------------------------------------------------------
+// Arcs.
+// -----------------------------------------------------------------------------
+
+// The largest distance, in pixels at FIXED_POINT_SCALE, between an arc and
+// the chords that approximate it, for each mode.
+#define FCTX_ARC_ERROR_AA (FIX1 / 8)
+#define FCTX_ARC_ERROR_BW (FIX1 / 2)
+#define FCTX_ARC_MAX_SEGMENTS 256
+
+/**
+ * Plot the ring sector between two radii, running clockwise from start_angle
+ * to end_angle (in TRIG_MAX_ANGLE units, with 0 at 12 o'clock), as one closed
+ * outline.  The angles may be given in either order, and a sweep of
+ * TRIG_MAX_ANGLE or more draws the whole ring.  The arcs
+ * are split into chords just short enough for the arc's size on screen, and
+ * the radial edges end exactly at the given angles.  Coordinates go through
+ * the current transform; call between fctx_begin_fill and fctx_end_fill.
+ */
+void fctx_draw_ring_arc(FContext* fctx, FPoint center, fixed_t outer_radius, fixed_t inner_radius,
+            int32_t start_angle, int32_t end_angle);
+
+/**
+ * Plot a pie sector: a ring arc with an inner radius of zero.
+ */
+void fctx_draw_pie(FContext* fctx, FPoint center, fixed_t radius, int32_t start_angle, int32_t end_angle);
+
 // -----------------------------------------------------------------------------
 // Text drawing.
 // -----------------------------------------------------------------------------
@@ -88,4 +411,118 @@ typedef enum {
 } FTextAnchor;
 
 void fctx_set_text_em_height(FContext* fctx, FFont* font, int16_t pixels);
+
+/**
+ * The advance, in font units, at which the first glyph of a string is placed
+ * for the given alignment and anchor.
+ */
+FPoint fctx_string_origin(const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor);
 void fctx_draw_string(FContext* fctx, const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor);
+
+// -----------------------------------------------------------------------------
+// Flattened paths.
+//
+// A flattened path is the list of edges that a draw call would plot, recorded
+// after the scale has been applied but before the offset.  It can be drawn
+// again at any offset and rotation without re-interpreting the path commands.
+// -----------------------------------------------------------------------------
+
+/* A point with this x value separates the polylines of a flattened path. */
+#define FFLAT_PATH_BREAK INT32_MIN
+
+typedef struct FTransform {
+    FPoint offset;
+    int32_t rotation;
+} FTransform;
+
+typedef struct FFlatPath {
+    uint16_t count;
+    uint16_t capacity;
+    FPoint* points;
+    FPoint min;
+    FPoint max;
+} FFlatPath;
+
+void fflat_path_init(FFlatPath* flat);
+void fflat_path_clear(FFlatPath* flat);
+void fflat_path_destroy(FFlatPath* flat);
+
+/**
+ * Record the edges of a compiled path, using the current scale of the context.
+ * The edges are appended to the flattened path.
+ * @return false if the flattened path could not be grown.
+ */
+bool fctx_flatten_commands(FContext* fctx, FFlatPath* flat, FPoint advance, void* path_data, uint16_t length);
+bool fctx_flatten_string(FContext* fctx, FFlatPath* flat, const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor);
+
+/**
+ * Rotate and offset a flattened path into screen coordinates, applying the
+ * subpixel adjustment of the context.  The bounds of dst are updated.
+ */
+bool fctx_transform_flat_path(FContext* fctx, const FFlatPath* src, const FTransform* transform, FFlatPath* dst);
+
+/**
+ * Plot a flattened path that is already in screen coordinates.
+ */
+void fctx_plot_flat_path(FContext* fctx, const FFlatPath* flat);
+
+/**
+ * Rotate, offset and plot a flattened path in one pass.
+ */
+void fctx_draw_flat_path(FContext* fctx, const FFlatPath* flat, const FTransform* transform);
+
+/**
+ * Draw count instances of a flattened path, each with its own transform, into
+ * the current fill.  The path is flattened once, and each instance only
+ * rotates and offsets its points before plotting them.  Instances that fall
+ * wholly above, below or right of the screen are skipped.
+ */
+void fctx_draw_flat_path_instances(FContext* fctx, const FFlatPath* flat, const FTransform* transforms, uint16_t count);
+
+/**
+ * Draw count instances of a flattened path spaced evenly around a full turn:
+ * instance i is drawn at transform->offset with a rotation of
+ * transform->rotation + i * TRIG_MAX_ANGLE / count.  Dial ticks and rosettes
+ * are drawn by placing the shape at its radius in the flattened path.
+ */
+void fctx_draw_flat_path_symmetric(FContext* fctx, const FFlatPath* flat, const FTransform* transform, uint16_t count);
+
+/**
+ * Flatten a compiled path with the current scale and draw it at each of the
+ * transforms, as fctx_draw_flat_path_instances.
+ * @return false if there was not enough memory to flatten the path.
+ */
+bool fctx_draw_commands_instances(FContext* fctx, FPoint advance, void* path_data, uint16_t length,
+            const FTransform* transforms, uint16_t count);
+
+// -----------------------------------------------------------------------------
+// Static paths.
+//
+// A static path is a flattened path generated at build time by tools/flatten
+// as const data, so that it is linked into flash and drawn without loading,
+// copying or interpreting a path resource.  Its points are in path units
+// (1/16 pixel) at a scale of one, with their bounds.
+// -----------------------------------------------------------------------------
+
+/* A point with this x value separates the polylines of a static path. */
+#define FSTATIC_PATH_BREAK INT16_MIN
+
+typedef struct FPoint16 {
+    fixed16_t x;
+    fixed16_t y;
+} FPoint16;
+
+typedef struct FStaticPath {
+    uint16_t count;
+    const FPoint16* points;
+    FPoint16 min;
+    FPoint16 max;
+} FStaticPath;
+
+/**
+ * Scale a static path by the current scale of the context, then rotate,
+ * offset and plot it as fctx_draw_flat_path does.  Call this between
+ * fctx_begin_fill and fctx_end_fill.  Curves were flattened into five chords
+ * each at a scale of one, so scaling up by more than about two shows them.
+ */
+void fctx_draw_static_path(FContext* fctx, const FStaticPath* path, const FTransform* transform);
@@ -0,0 +1,84 @@
+#pragma once
+#include "fctx.h"
+
+// -----------------------------------------------------------------------------
+// Retained display list.
+//
+// Each node holds a path or a string, a fill color and a transform.  The
+// flattened edges of every node are cached, so a node is only re-flattened
+// when its content or scale changes, and only re-transformed when its offset
+// or rotation changes.
+// -----------------------------------------------------------------------------
+
+typedef enum {
+    FDisplayNodeTypePath = 0,
+    FDisplayNodeTypeText
+} FDisplayNodeType;
+
+typedef struct FDisplayNode {
+    FDisplayNodeType type;
+    uint8_t dirty;
+    bool visible;
+    GColor fill_color;
+    FPoint pivot;
+    FPoint scale_from;
+    FPoint scale_to;
+    FTransform transform;
+    union {
+        struct {
+            void* data;
+            uint16_t length;
+        } path;
+        struct {
+            char* string;
+            FFont* font;
+            int16_t em_height;
+            GTextAlignment alignment;
+            FTextAnchor anchor;
+        } text;
+    };
+    FFlatPath local;
+    FFlatPath screen;
+} FDisplayNode;
+
+typedef struct FDisplayList {
+    uint16_t count;
+    uint16_t capacity;
+    fixed_t subpixel_adjust;
+    bool coarse_curves;
+    GRect changed_bounds;
+    FDisplayNode* nodes;
+} FDisplayList;
+
+FDisplayList* fdisplay_list_create(uint16_t capacity);
+void fdisplay_list_destroy(FDisplayList* list);
+
+/**
+ * Add a node to the list.  Nodes are rendered in the order they are added.
+ * @return the node, or NULL if the list is full.
+ */
+FDisplayNode* fdisplay_list_add_path(FDisplayList* list, void* path_data, uint16_t length, GColor fill_color);
+FDisplayNode* fdisplay_list_add_text(FDisplayList* list, const char* text, FFont* font, int16_t em_height,
+                                     GTextAlignment alignment, FTextAnchor anchor, GColor fill_color);
+
+void fdisplay_node_set_fill_color(FDisplayNode* node, GColor c);
+void fdisplay_node_set_visible(FDisplayNode* node, bool visible);
+void fdisplay_node_set_offset(FDisplayNode* node, FPoint offset);
+void fdisplay_node_set_rotation(FDisplayNode* node, int32_t rotation);
+/* The pivot moves the origin of a path node's commands; text is placed by its
+ * alignment and anchor instead.  The scale applies to both types, and to text
+ * on top of its em height. */
+void fdisplay_node_set_pivot(FDisplayNode* node, FPoint pivot);
+void fdisplay_node_set_scale(FDisplayNode* node, FPoint scale_from, FPoint scale_to);
+
+/* Change the content of a path or text node.  Each does nothing to a node of
+ * the other type. */
+void fdisplay_node_set_path(FDisplayNode* node, void* path_data, uint16_t length);
+void fdisplay_node_set_text(FDisplayNode* node, const char* text);
+
+/**
+ * Render every visible node of the list, one fill per node.  On return,
+ * list->changed_bounds holds the union of the old and new screen bounds of
+ * the nodes that changed since the previous render.
+ */
+void fctx_render_list(FContext* fctx, FDisplayList* list);
@@ -22,7 +22,12 @@ typedef struct __attribute__((__packed__)) FGlyph {
     fixed16_t horiz_adv_x;
 } FGlyph;
 
+/* Set in path_data_length while the outline of a glyph is still being loaded
+   (see fresource_arena_load).  Such a glyph advances but draws nothing. */
+#define FFONT_GLYPH_PENDING 0x8000
+
 FFont* ffont_create_from_resource(uint32_t resource_id);
+FFont* ffont_load_from_resource_into_buffer(uint32_t resource_id, void* buffer);
 void ffont_destroy(FFont* font);
 #if 0
 void ffont_debug_log(FFont* font, uint8_t log_level);
@@ -30,6 +35,26 @@ void ffont_debug_log(FFont* font, uint8_t log_level);
 FGlyph* ffont_glyph_info(FFont* font, uint16_t unicode);
 void* ffont_glyph_outline(FFont* font, FGlyph* glyph);
 
+/* The size of a loaded font resource. */
+size_t ffont_size(FFont* font);
+
+/**
+ * Check that size bytes hold a well-formed font: the glyph index and table
+ * fit, the ranges cover no more glyphs than the table holds, and every
+ * outline lies within the data and passes fctx_path_validate.
+ */
+bool ffont_validate(const void* data, size_t size);
+
+/**
+ * Re-encode the glyph outlines of a font as packed path data (see
+ * FCTX_PACKED_PATH_MAGIC).  The packed font draws exactly the same text.
+ * @param out receives the packed font, and must hold at least
+ * FPATH_PACKED_SIZE_MAX(ffont_size(font)) bytes.
+ * @return the size of the packed font, or 0 if its outlines would be more
+ * than 64 KB.
+ */
+size_t ffont_pack(FFont* font, void* out);
+
 /**
  * Decode the next byte of a UTF-8 byte stream.
  * Initialize state to 0 the before calling this function for the first
@@ -0,0 +1,50 @@
+#pragma once
+#include "fctx.h"
+#include "ffont.h"
+
+// -----------------------------------------------------------------------------
+// Glyph coverage atlas.
+//
+// Caches the anti-aliased coverage of each glyph for a given font, scale
+// and horizontal subpixel phase, so that text which is redrawn every frame is
+// composited from masks rather than plotted and resolved again.  Text drawn
+// through the atlas is unrotated, and its baseline is snapped to a whole
+// pixel.  Masks are evicted least recently used first to stay within the
+// atlas budget.
+// -----------------------------------------------------------------------------
+
+/* The number of horizontal subpixel positions cached for each glyph. */
+#define FGLYPH_ATLAS_X_PHASES 4
+
+struct FGlyphMask;
+typedef struct FGlyphMask FGlyphMask;
+
+typedef struct FGlyphAtlas {
+    size_t budget;
+    size_t size;
+    uint32_t clock;
+    uint16_t count;
+    uint16_t capacity;
+    FGlyphMask** masks;
+} FGlyphAtlas;
+
+/**
+ * Create an atlas that holds at most budget bytes of cached masks.
+ */
+FGlyphAtlas* fglyph_atlas_create(size_t budget);
+void fglyph_atlas_destroy(FGlyphAtlas* atlas);
+void fglyph_atlas_clear(FGlyphAtlas* atlas);
+
+/**
+ * The number of bytes of masks currently held by the atlas.
+ */
+size_t fglyph_atlas_size(FGlyphAtlas* atlas);
+
+/**
+ * Draw a string with the fill color, offset and scale of the context,
+ * compositing it to the GContext immediately.  Call this outside of
+ * fctx_begin_fill and fctx_end_fill.  On BW contexts, or without an atlas, the
+ * string is drawn as its own fill instead.
+ */
+void fctx_draw_string_atlas(FContext* fctx, FGlyphAtlas* atlas, const char* text, FFont* font,
+                            GTextAlignment alignment, FTextAnchor anchor);
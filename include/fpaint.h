@@ -0,0 +1,64 @@
+#pragma once
+#include "fctx.h"
+
+// -----------------------------------------------------------------------------
+// Paints.
+//
+// A paint takes the place of the solid fill color of a context.  When a fill
+// is resolved, the paint is called once for each run of pixels in a row that
+// have the same coverage, and writes those pixels to the frame buffer.
+// Gradients are ordered-dithered to the 64 colors of color platforms, and to
+// black and white on BW platforms.
+// -----------------------------------------------------------------------------
+
+/**
+ * Paint the pixels x0 to x1 inclusive of a frame buffer row.
+ * @param row_data the row data of the frame buffer, as in GBitmapDataRowInfo:
+ *        a byte per pixel on color platforms, a bit per pixel on BW platforms.
+ * @param coverage the coverage of each pixel in the span, in eighths.
+ *        Always 8 outside of AA mode.
+ */
+typedef void (*fpaint_span_func)(const FPaint* paint, uint8_t* row_data, int16_t row, int16_t x0, int16_t x1, uint8_t coverage);
+
+struct FPaint {
+    fpaint_span_func span;
+    union {
+        struct {
+            int32_t t0;     /* gradient position at pixel (0, 0), 16.16 */
+            int32_t tx;     /* step per pixel in x */
+            int32_t ty;     /* step per pixel in y */
+            GColor c0;
+            GColor c1;
+        } linear;
+        struct {
+            FPoint center;
+            fixed_t radius;
+            int32_t inv_radius;
+            GColor c0;
+            GColor c1;
+        } radial;
+        struct {
+            GBitmap* bitmap;
+            GPoint origin;
+        } pattern;
+        void* user_data;
+    };
+};
+
+/**
+ * A linear gradient from c0 at p0 to c1 at p1, in screen coordinates.
+ */
+void fpaint_init_linear_gradient(FPaint* paint, FPoint p0, GColor c0, FPoint p1, GColor c1);
+
+/**
+ * A radial gradient from c0 at the center to c1 at the radius, in screen
+ * coordinates.
+ */
+void fpaint_init_radial_gradient(FPaint* paint, FPoint center, fixed_t radius, GColor c0, GColor c1);
+
+/**
+ * A bitmap repeated across the screen with its top left corner at origin.
+ * The bitmap must be in the frame buffer's pixel format: GBitmapFormat8Bit on
+ * color platforms, GBitmapFormat1Bit on BW platforms.
+ */
+void fpaint_init_pattern(FPaint* paint, GBitmap* bitmap, GPoint origin);
@@ -0,0 +1,81 @@
+#pragma once
+#include "fctx.h"
+
+// -----------------------------------------------------------------------------
+// Compiled SVG path resources.
+// -----------------------------------------------------------------------------
+
+typedef struct FPath {
+    uint16_t size;
+    void* data;
+} FPath;
+
+FPath* fpath_create_from_resource(uint32_t resource_id);
+void fpath_destroy(FPath* fpath);
+
+/**
+ * Load a path resource into caller-owned memory.  The buffer must hold at
+ * least sizeof(FPath) + resource_size() bytes; the path data is stored
+ * immediately after the FPath header.
+ *
+ * @param resource_id the path resource to load.
+ * @param buffer the memory to load the path into.
+ * @return the path, located at the start of the buffer.
+ */
+FPath* fpath_load_from_resource_into_buffer(uint32_t resource_id, void* buffer);
+
+/* The largest size of packed path data made from length bytes of path data. */
+#define FPATH_PACKED_SIZE_MAX(length) ((length) * 3 / 2 + 1)
+
+/**
+ * Re-encode path data, in either format, as packed path data (see
+ * FCTX_PACKED_PATH_MAGIC), which draws exactly the same shape.
+ * @param out receives the packed data, and must hold at least
+ * FPATH_PACKED_SIZE_MAX(length) bytes.
+ * @return the size of the packed data, or 0 if it would be more than 64 KB.
+ */
+uint16_t fpath_pack(const void* path_data, uint16_t length, void* out);
+
+// -----------------------------------------------------------------------------
+// Level of detail.
+//
+// Simplified copies of a path, for drawing it at small scales.  Each level is
+// simplified with a tolerance, in path units, of FPATH_LOD_ERROR times a power
+// of two up to 1 << FPATH_LOD_MAX_SHIFT: curves that are flatter than the
+// tolerance become lines, runs of lines that stay within it become a single
+// line, and subpaths that fit within it are dropped.
+// -----------------------------------------------------------------------------
+
+#define FPATH_LOD_MAX_LEVELS 6
+#define FPATH_LOD_MAX_SHIFT 8
+
+/* The largest error, in screen fixed point units, that the renderer accepts
+   when it picks a level: one AA subpixel row. */
+#define FPATH_LOD_ERROR (FIX1 / 8)
+
+typedef struct FPathLevel {
+    fixed_t tolerance;
+    uint16_t size;
+    void* data;
+} FPathLevel;
+
+typedef struct FPathLOD {
+    const FPath* path;
+    uint8_t count;
+    FPathLevel levels[FPATH_LOD_MAX_LEVELS];
+} FPathLOD;
+
+/**
+ * Build up to max_levels levels of detail for a path, the first of which is
+ * the path itself.  Tolerances at which the path would be no smaller than the
+ * level before are skipped.  The path must outlive the levels.
+ * @return NULL if the levels could not be allocated.
+ */
+FPathLOD* fpath_create_lod(const FPath* path, uint8_t max_levels);
+void fpath_destroy_lod(FPathLOD* lod);
+
+/**
+ * Draw the coarsest level of a path whose tolerance, at the current scale of
+ * the context, is no more than FPATH_LOD_ERROR.
+ */
+void fctx_draw_path_lod(FContext* fctx, const FPathLOD* lod, FPoint advance);
@@ -0,0 +1,129 @@
+#pragma once
+#include "ffont.h"
+#include "fpath.h"
+
+// -----------------------------------------------------------------------------
+// Resource arena.
+//
+// Loads a set of font and path resources into a single heap block, so that
+// they can be allocated and freed together without fragmenting the heap.
+// -----------------------------------------------------------------------------
+
+typedef enum {
+    FResourceTypeFont = 0,
+    FResourceTypePath
+} FResourceType;
+
+typedef struct FResourceSpec {
+    uint32_t resource_id;
+    FResourceType type;
+} FResourceSpec;
+
+struct FResourceLoader;
+
+typedef struct FResourceArenaItem {
+    FResourceType type;
+    void* data;
+} FResourceArenaItem;
+
+typedef struct FResourceArena {
+    size_t size;
+    uint16_t count;
+    struct FResourceLoader* loader;
+    FResourceArenaItem items[];
+} FResourceArena;
+
+/**
+ * Size, allocate and load a list of resources in one block.
+ *
+ * @param specs the resources to load, in order.
+ * @param count the number of entries in specs.
+ * @return the arena, or NULL if the allocation failed.
+ */
+FResourceArena* fresource_arena_create(const FResourceSpec* specs, uint16_t count);
+void fresource_arena_destroy(FResourceArena* arena);
+
+/**
+ * Compute the number of bytes fresource_arena_create will allocate.
+ */
+size_t fresource_arena_size(const FResourceSpec* specs, uint16_t count);
+
+/* The font or path at an index of the arena, or NULL if the index is out of
+ * range or holds the other type. */
+FFont* fresource_arena_font(FResourceArena* arena, uint16_t index);
+FPath* fresource_arena_path(FResourceArena* arena, uint16_t index);
+
+// -----------------------------------------------------------------------------
+// Incremental loading.
+//
+// Loads the resources of an arena in chunks, from app_timer callbacks, so that
+// the first window can be drawn before they are all loaded.  A path becomes
+// available when all of it is loaded.  A font becomes available when its glyph
+// table is loaded, and each glyph draws as soon as its outline is loaded;
+// until then it advances the text but draws nothing.
+// -----------------------------------------------------------------------------
+
+#define FRESOURCE_MIN_CHUNK 64
+
+typedef void (*FResourceProgressHandler)(FResourceArena* arena, size_t loaded, size_t total, void* context);
+typedef void (*FResourceCompleteHandler)(FResourceArena* arena, void* context);
+
+typedef struct FResourceLoaderHandlers {
+    // Called after each chunk, e.g. to mark the layer dirty.  May be NULL.
+    FResourceProgressHandler progress;
+    // Called once, after the last chunk.  May be NULL.
+    FResourceCompleteHandler complete;
+} FResourceLoaderHandlers;
+
+/**
+ * Allocate an arena and start loading its resources in the background.  The
+ * fresource_arena_font and fresource_arena_path accessors return NULL for
+ * resources that are not yet available.  Destroying the arena stops loading.
+ *
+ * @param specs the resources to load, in order.
+ * @param count the number of entries in specs.
+ * @param chunk_size the number of bytes to load in each app_timer callback,
+ * at least FRESOURCE_MIN_CHUNK.
+ * @param handlers called as the loading progresses and completes.
+ * @param context passed to the handlers.
+ * @return the arena, or NULL if an allocation failed.
+ */
+FResourceArena* fresource_arena_load(const FResourceSpec* specs, uint16_t count, size_t chunk_size,
+                                     FResourceLoaderHandlers handlers, void* context);
+
+/**
+ * Whether every resource in the arena is loaded.
+ */
+bool fresource_arena_is_loaded(const FResourceArena* arena);
+
+#ifdef FCTX_HOST
+// -----------------------------------------------------------------------------
+// Mapped resource files (host builds only).
+//
+// Maps compiled .ffont and .fpath files read-only instead of copying them to
+// the heap, so that threads and forked workers rendering from the same files
+// share one copy in the page cache.  Each file is validated once, when it is
+// mapped.  The font or path is a view into the mapping: it must not be
+// modified, and it can be drawn from several threads at once.  The file must
+// not be rewritten while it is mapped.
+// -----------------------------------------------------------------------------
+
+typedef struct FResourceMap {
+    FResourceType type;
+    size_t size;
+    void* data;
+    FPath path;
+} FResourceMap;
+
+/**
+ * Map a resource file and check that it holds a well-formed font (see
+ * ffont_validate) or path (see fctx_path_validate).
+ * @return the mapping, or NULL if the file cannot be mapped or is malformed.
+ */
+FResourceMap* fresource_map_file(const char* path, FResourceType type);
+void fresource_unmap(FResourceMap* map);
+
+/* The font or path in a mapping, or NULL if it holds the other type. */
+FFont* fresource_map_font(FResourceMap* map);
+FPath* fresource_map_path(FResourceMap* map);
+#endif
@@ -0,0 +1,45 @@
+
+#include "fbudget.h"
+
+static uint32_t fbudget_default_clock() {
+    time_t seconds;
+    uint16_t millis;
+    time_ms(&seconds, &millis);
+    // Unsigned, so that it wraps rather than overflows; only differences are used.
+    return (uint32_t)seconds * 1000u + millis;
+}
+
+void fbudget_init(FFrameBudget* budget, uint32_t budget_ms) {
+    budget->budget = budget_ms;
+    budget->frame_start = 0;
+    budget->frame_time = 0;
+    budget->quality = FQualityFull;
+    budget->aa = fctx_is_aa_enabled();
+    budget->clock = &fbudget_default_clock;
+}
+
+void fbudget_begin_frame(FFrameBudget* budget) {
+    fctx_enable_aa(budget->aa && budget->quality < FQualityBW);
+    fctx_enable_coarse_curves(budget->quality >= FQualityCoarseCurves);
+    budget->frame_start = budget->clock();
+}
+
+void fbudget_end_frame(FFrameBudget* budget, bool animating) {
+    budget->frame_time = budget->clock() - budget->frame_start;
+    if (!animating) {
+        budget->quality = FQualityFull;
+        return;
+    }
+    // Without AA, coarse curves are the only step down.
+    FQuality lowest = budget->aa ? FQualityBW : FQualityCoarseCurves;
+    if (budget->frame_time > budget->budget && budget->quality < lowest) {
+        budget->quality = (FQuality)(budget->quality + 1);
+    }
+}
+
+FContextMode fbudget_mode(FFrameBudget* budget, bool moving) {
+    if (!budget->aa || budget->quality >= FQualityBW || (moving && budget->quality >= FQualityBWMoving)) {
+        return FContextModeBW;
+    }
+    return FContextModeAA;
+}
@@ -1,7 +1,13 @@
 
 #include "fctx.h"
 #include "ffont.h"
+#include "fpaint.h"
+#include "fdither.h"
 #include <stdlib.h>
+#include <string.h>
+#if defined(FCTX_STATS) && defined(FCTX_HOST)
+#include <time.h>
+#endif
 
 
 /*
@@ -37,6 +43,10 @@
 
 #define MAX_ANGLE_TOLERANCE ((TRIG_MAX_ANGLE / 360) * 5)
 
+// Used for the edge plotters, so that the mode-specialized path interpreters
+// do not pay for a call per edge.
+#define FCTX_ALWAYS_INLINE static inline __attribute__((always_inline))
+
 bool checkObject(void* obj, const char* objname) {
     if (!obj) {
         APP_LOG(APP_LOG_LEVEL_ERROR, "NULL %s", objname);
@@ -45,11 +55,59 @@ bool checkObject(void* obj, const char* objname) {
     return true;
 }
 
+// --------------------------------------------------------------------------
+// Instrumentation.
+// --------------------------------------------------------------------------
+
+#ifdef FCTX_STATS
+
+static uint32_t fctx_default_clock() {
+#ifdef FCTX_HOST
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000u + (uint32_t)(ts.tv_nsec / 1000);
+#else
+    time_t seconds;
+    uint16_t millis;
+    time_ms(&seconds, &millis);
+    // Unsigned, so that it wraps rather than overflows; only differences are used.
+    return (uint32_t)seconds * 1000000u + millis * 1000u;
+#endif
+}
+
+static fctx_clock_func s_stats_clock = &fctx_default_clock;
+
+void fctx_set_stats_clock(fctx_clock_func clock) {
+    s_stats_clock = clock ? clock : &fctx_default_clock;
+}
+
+uint32_t fctx_stats_clock() {
+    return s_stats_clock();
+}
+
+void fctx_reset_stats(FContext* fctx) {
+    memset(&fctx->stats, 0, sizeof(FContextStats));
+}
+
+#define FCTX_STAT_BEGIN_PHASE(fctx) ((fctx)->stats.phase_start = fctx_stats_clock())
+#define FCTX_STAT_END_PHASE(fctx, field) do { \
+        uint32_t now = fctx_stats_clock(); \
+        (fctx)->stats.field += now - (fctx)->stats.phase_start; \
+        (fctx)->stats.phase_start = now; \
+    } while (0)
+
+#else
+
+#define FCTX_STAT_BEGIN_PHASE(fctx)
+#define FCTX_STAT_END_PHASE(fctx, field)
+
+#endif
+
 // --------------------------------------------------------------------------
 // Drawing support that is shared between BW and AA.
 // --------------------------------------------------------------------------
 
-void floorDivMod(int32_t numerator, int32_t denominator, int32_t* floor, int32_t* mod ) {
+void floorDivMod(fixed_wide_t numerator, fixed_wide_t denominator, int32_t* floor, int32_t* mod ) {
     Assert(denominator > 0); // we assume it's positive
     if (numerator >= 0) {
         // positive case, C is okay
@@ -90,9 +148,11 @@ int32_t edge_step(Edge* e) {
     return e->height;
 }
 
+static void fctx_destroy_bands(FContext* fctx);
+
 void fctx_begin_fill(FContext* fctx) {
 
-    GRect bounds = gbitmap_get_bounds(fctx->flag_buffer);
+    GRect bounds = fctx->flag_bounds;
     fctx->extent_max.x = INT_TO_FIXED(bounds.origin.x);
     fctx->extent_max.y = INT_TO_FIXED(bounds.origin.y);
     fctx->extent_min.x = INT_TO_FIXED(bounds.origin.x + bounds.size.w);
@@ -100,23 +160,109 @@ void fctx_begin_fill(FContext* fctx) {
 
     fctx->path_cur_point.x = 0;
     fctx->path_cur_point.y = 0;
+
+    FCTX_STAT_BEGIN_PHASE(fctx);
 }
 
 void fctx_deinit_context(FContext* fctx) {
-    if (fctx->gctx) {
+    if (fctx->flag_buffer) {
         gbitmap_destroy(fctx->flag_buffer);
-        fctx->gctx = NULL;
+        fctx->flag_buffer = NULL;
     }
+    if (fctx->bands) {
+        fctx_destroy_bands(fctx);
+    }
+    fctx_end_occlusion(fctx);
+    fctx->gctx = NULL;
 }
 
 void fctx_set_fill_color(FContext* fctx, GColor c) {
     fctx->fill_color = c;
+    fctx->fill_paint = NULL;
+}
+
+void fctx_set_fill_paint(FContext* fctx, const FPaint* paint) {
+    fctx->fill_paint = paint;
 }
 
 void fctx_set_offset(FContext* fctx, FPoint offset) {
     fctx->transform_offset = offset;
 }
 
+// A context whose flag buffer could not be allocated draws nothing.
+
+static void fctx_plot_edge_null(FContext* fctx, FPoint* a, FPoint* b) {
+}
+
+static void fctx_end_fill_null(FContext* fctx) {
+}
+
+static const FContextOps k_null_ops = {
+    .plot_edge = &fctx_plot_edge_null,
+    .end_fill = &fctx_end_fill_null
+};
+
+// --------------------------------------------------------------------------
+// Occlusion - front to back drawing.
+// --------------------------------------------------------------------------
+
+/*
+ * The coverage claimed by the fills drawn so far, per frame buffer pixel: a
+ * nibble of eighths in AA mode, and a bit in BW mode.  Rows are indexed by
+ * frame buffer row, so that banded contexts share one mask across bands.
+ */
+typedef struct FOcclusion {
+    GColor8 background;
+    uint16_t stride;
+    uint8_t* scratch;       // one frame buffer row, for paints at edges
+    uint8_t coverage[];
+} FOcclusion;
+
+bool fctx_begin_occlusion(FContext* fctx, GColor background) {
+
+    fctx_end_occlusion(fctx);
+    if (fctx->ops == &k_null_ops || (!fctx->gctx && !fctx->target)) {
+        return false;
+    }
+#ifdef PBL_COLOR
+    // The alpha of a layer would need a coverage of its own.
+    if (fctx->target) {
+        return false;
+    }
+#else
+    // A dithered pixel is either set or not, so there is no coverage left
+    // over to give to the fills behind it.
+    if (fctx->mode == FContextModeAA) {
+        return false;
+    }
+#endif
+
+    GBitmap* fb = fctx_capture_target(fctx);
+    if (!fb) {
+        return false;
+    }
+    GSize size = gbitmap_get_bounds(fb).size;
+    fctx_release_target(fctx, fb);
+
+    uint16_t stride = (fctx->mode == FContextModeAA) ? (size.w + 1) / 2 : (size.w + 7) / 8;
+    uint16_t scratch = (fctx->mode == FContextModeAA) ? size.w : 0;
+    FOcclusion* occlusion = malloc(sizeof(FOcclusion) + stride * size.h + scratch);
+    if (!CHECK(occlusion)) {
+        return false;
+    }
+    occlusion->background = background;
+    occlusion->stride = stride;
+    occlusion->scratch = occlusion->coverage + stride * size.h;
+    memset(occlusion->coverage, 0, stride * size.h);
+    fctx->occlusion = occlusion;
+    return true;
+}
+
+void fctx_end_occlusion(FContext* fctx) {
+    free(fctx->occlusion);
+    fctx->occlusion = NULL;
+}
+
 // --------------------------------------------------------------------------
 // BW - black and white drawing with 1 bit-per-pixel flag buffer.
 // --------------------------------------------------------------------------
@@ -140,35 +286,32 @@ void edge_init(Edge* e, FPoint* top, FPoint* bottom) {
     int32_t yEnd = fceil(bottom->y);
     e->height = yEnd - e->y;
     if (e->height)    {
-        int32_t dN = bottom->y - top->y;
-        int32_t dM = bottom->x - top->x;
-        int32_t initialNumerator = dM * 16 * e->y - dM * top->y +
-        dN * top->x - 1 + dN * 16;
-        floorDivMod(initialNumerator, dN*16, &e->x, &e->errorTerm);
-        floorDivMod(dM*16, dN*16, &e->xStep, &e->numerator);
-        e->denominator = dN*16;
+        fixed_wide_t dN = bottom->y - top->y;
+        fixed_wide_t dM = bottom->x - top->x;
+        fixed_wide_t initialNumerator = dM * FIXED_POINT_SCALE * e->y - dM * top->y +
+        dN * top->x - 1 + dN * FIXED_POINT_SCALE;
+        floorDivMod(initialNumerator, dN*FIXED_POINT_SCALE, &e->x, &e->errorTerm);
+        floorDivMod(dM*FIXED_POINT_SCALE, dN*FIXED_POINT_SCALE, &e->xStep, &e->numerator);
+        e->denominator = dN*FIXED_POINT_SCALE;
     }
 }
 
-void fctx_init_context_bw(FContext* fctx, GContext* gctx) {
-
-    GBitmap* frameBuffer = graphics_capture_frame_buffer(gctx);
-    if (frameBuffer) {
-        fctx->flag_bounds = gbitmap_get_bounds(frameBuffer);
-        graphics_release_frame_buffer(gctx, frameBuffer);
+static bool fctx_init_context_bw(FContext* fctx, GBitmap* target, int16_t rows) {
 
-        fctx->flag_buffer = gbitmap_create_blank(fctx->flag_bounds.size, GBitmapFormat1Bit);
-        CHECK(fctx->flag_buffer);
+    fctx->flag_bounds = GRect(0, 0, gbitmap_get_bounds(target).size.w, rows);
+    fctx->flag_buffer = gbitmap_create_blank(fctx->flag_bounds.size, GBitmapFormat1Bit);
 
-        fctx->gctx = gctx;
-        fctx->subpixel_adjust = -FIXED_POINT_SCALE / 2;
-        fctx->transform_offset = FPointZero;
-        fctx->transform_scale_from = FPointOne;
-        fctx->transform_scale_to = FPointOne;
-    }
+    fctx->subpixel_adjust = -FIXED_POINT_SCALE / 2;
+    fctx->transform_offset = FPointZero;
+    fctx->transform_scale_from = FPointOne;
+    fctx->transform_scale_to = FPointOne;
+#ifdef FCTX_STATS
+    fctx_reset_stats(fctx);
+#endif
+    return CHECK(fctx->flag_buffer);
 }
 
-void fctx_plot_edge_bw(FContext* fctx, FPoint* a, FPoint* b) {
+FCTX_ALWAYS_INLINE void fctx_plot_edge_bw(FContext* fctx, FPoint* a, FPoint* b) {
 
     Edge edge;
     if (a->y > b->y) {
@@ -181,18 +324,50 @@ void fctx_plot_edge_bw(FContext* fctx, FPoint* a, FPoint* b) {
     int16_t stride = gbitmap_get_bytes_per_row(fctx->flag_buffer);
     int16_t max_x = fctx->flag_bounds.size.w - 1;
     int16_t max_y = fctx->flag_bounds.size.h - 1;
+    FCTX_STAT(fctx, edges_plotted, 1);
+
+    if (a->x == b->x) {
+        // A vertical edge toggles the same bit on every row.  Rows are
+        // counted as the DDA loop below would count them.
+        int32_t y = edge.y;
+        int32_t end = edge.y + edge.height;
+        if (y < 0) {
+            FCTX_STAT(fctx, dda_steps_skipped, ((end < 0) ? end : 0) - y);
+            y = 0;
+        }
+        if (end > max_y + 1) end = max_y + 1;
+        if (y >= end) {
+            return;
+        }
+        FCTX_STAT(fctx, dda_steps, end - y);
+        if (edge.x > max_x) {
+            FCTX_STAT(fctx, dda_steps_wasted, end - y);
+            return;
+        }
+        int16_t x = (edge.x < 0) ? 0 : edge.x;
+        uint8_t mask = 1 << (x % 8);
+        uint8_t* p = data + y * stride + x / 8;
+        for (; y < end; ++y, p += stride) {
+            *p ^= mask;
+        }
+        return;
+    }
 
     while (edge.height > 0 && edge.y < 0) {
+        FCTX_STAT(fctx, dda_steps_skipped, 1);
         edge_step(&edge);
     }
 
     while (edge.height > 0 && edge.y <= max_y) {
+        FCTX_STAT(fctx, dda_steps, 1);
         if (edge.x < 0) {
             uint8_t* p = data + edge.y * stride;
             *p ^= 1;
         } else if (edge.x <= max_x) {
             uint8_t* p = data + edge.y * stride + edge.x / 8;
             *p ^= (1 << (edge.x % 8));
+        } else {
+            FCTX_STAT(fctx, dda_steps_wasted, 1);
         }
         edge_step(&edge);
     }
@@ -214,7 +389,87 @@ static inline void fctx_plot_point_bw(FContext* fctx, int16_t x, int16_t y) {
     }
 }
 
-void fctx_end_fill_bw(FContext* fctx) {
+/*
+ * Resolve one row of the flag buffer through the fill paint, one span per run
+ * of pixels inside the shape.
+ * @return the column after the last one scanned.
+ */
+static int16_t fctx_paint_row_bw(FContext* fctx, uint8_t* dest, uint8_t* flags, int16_t row, int16_t spanMin, int16_t spanMax) {
+    const FPaint* paint = fctx->fill_paint;
+    bool inside = false;
+    int16_t start = spanMin;
+    int16_t col;
+    for (col = spanMin; col <= spanMax; ++col) {
+        uint8_t* src = flags + col / 8;
+        uint8_t mask = 1 << (col % 8);
+        if (*src & mask) {
+            if (inside) {
+                FCTX_STAT(fctx, pixels_solid, col - start);
+                paint->span(paint, dest, row, start, col - 1, 8);
+            } else {
+                start = col;
+            }
+            inside = !inside;
+        }
+        *src &= ~mask;
+    }
+    if (inside) {
+        FCTX_STAT(fctx, pixels_solid, col - start);
+        paint->span(paint, dest, row, start, col - 1, 8);
+    }
+    return col;
+}
+
+/*
+ * Resolve one row of the flag buffer behind the fills drawn since
+ * fctx_begin_occlusion, writing only the pixels that none of them cover.
+ * @return the column after the last one scanned.
+ */
+static int16_t fctx_occlude_row_bw(FContext* fctx, uint8_t* dest, uint8_t* flags, int16_t row, int16_t spanMin, int16_t spanMax, uint8_t color) {
+    const FPaint* paint = fctx->fill_paint;
+    uint8_t* claimed = fctx->occlusion->coverage + row * fctx->occlusion->stride;
+    bool inside = false;
+    int16_t start = -1;     // the first column of the current run of exposed pixels
+    int16_t col;
+    for (col = spanMin; col <= spanMax; ++col) {
+        uint8_t* src = flags + col / 8;
+        uint8_t mask = 1 << (col % 8);
+        if (*src & mask) {
+            inside = !inside;
+        }
+        *src &= ~mask;
+        bool exposed = inside && !(claimed[col / 8] & mask);
+        if (start >= 0 && !exposed) {
+            paint->span(paint, dest, row, start, col - 1, 8);
+            start = -1;
+        }
+        if (!exposed) {
+            FCTX_STAT(fctx, pixels_occluded, inside ? 1 : 0);
+            continue;
+        }
+        claimed[col / 8] |= mask;
+        FCTX_STAT(fctx, pixels_solid, 1);
+        if (paint) {
+            start = (start < 0) ? col : start;
+        } else {
+#ifdef PBL_COLOR
+            dest[col] = color;
+#else
+            dest[col / 8] = (color & mask) | (dest[col / 8] & ~mask);
+#endif
+        }
+    }
+    if (start >= 0) {
+        paint->span(paint, dest, row, start, col - 1, 8);
+    }
+    return col;
+}
+
+/*
+ * Resolve rows rowMin to rowMax of the target through the flag buffer, whose
+ * first row is at band_top.
+ */
+static void fctx_resolve_rows_bw(FContext* fctx, GBitmap* fb, int16_t rowMin, int16_t rowMax) {
 
     uint8_t color;
 #ifdef PBL_COLOR
@@ -231,16 +486,9 @@ void fctx_end_fill_bw(FContext* fctx) {
     }
 #endif
 
-    int16_t rowMin = FIXED_TO_INT(fctx->extent_min.y);
-    int16_t rowMax = FIXED_TO_INT(fctx->extent_max.y);
     int16_t colMin = FIXED_TO_INT(fctx->extent_min.x);
     int16_t colMax = FIXED_TO_INT(fctx->extent_max.x);
 
-    if (rowMin < 0) rowMin = 0;
-    if (rowMax >= fctx->flag_bounds.size.h) rowMax = fctx->flag_bounds.size.h - 1;
-
-    GBitmap* fb = graphics_capture_frame_buffer(fctx->gctx);
-
     uint8_t* dest;
     uint8_t* src;
     uint8_t mask;
@@ -257,54 +505,95 @@ void fctx_end_fill_bw(FContext* fctx) {
         }
 #endif
         GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
-        GBitmapDataRowInfo flagRowInfo = gbitmap_get_data_row_info(fctx->flag_buffer, row);
+        GBitmapDataRowInfo flagRowInfo = gbitmap_get_data_row_info(fctx->flag_buffer, row - fctx->band_top);
         int16_t spanMin = (fbRowInfo.min_x > colMin) ? fbRowInfo.min_x : colMin;
         int16_t spanMax = (fbRowInfo.max_x < colMax) ? fbRowInfo.max_x : colMax;
+        if (fbRowInfo.min_x > 0) {
+            // A round display row: carry the edges to the left of the row
+            // into the span.
+            uint8_t carry = 0;
+            for (col = 0; col < fbRowInfo.min_x; ++col) {
+                src = flagRowInfo.data + col / 8;
+                mask = 1 << (col % 8);
+                if (*src & mask) {
+                    carry ^= 1;
+                    *src &= ~mask;
+                }
+            }
+            if (carry && spanMin <= spanMax) {
+                flagRowInfo.data[spanMin / 8] ^= 1 << (spanMin % 8);
+            }
+        }
+        FCTX_STAT(fctx, rows_scanned, 1);
+        FCTX_STAT(fctx, pixels_scanned, (spanMax >= spanMin) ? spanMax - spanMin + 1 : 0);
 
-        bool inside = false;
-        for (col = spanMin; col <= spanMax; ++col) {
+        if (fctx->occlusion) {
+            col = fctx_occlude_row_bw(fctx, fbRowInfo.data, flagRowInfo.data, row, spanMin, spanMax, color);
+        } else if (fctx->fill_paint) {
+            col = fctx_paint_row_bw(fctx, fbRowInfo.data, flagRowInfo.data, row, spanMin, spanMax);
+        } else {
+            bool inside = false;
+            for (col = spanMin; col <= spanMax; ++col) {
 
 #ifdef PBL_COLOR
-            dest = fbRowInfo.data + col;
+                dest = fbRowInfo.data + col;
 #else
-            dest = fbRowInfo.data + col / 8;
+                dest = fbRowInfo.data + col / 8;
 #endif
-            src = flagRowInfo.data + col / 8;
-            mask = 1 << (col % 8);
-            if (*src & mask) {
-                inside = !inside;
-            }
-            *src &= ~mask;
-            if (inside) {
+                src = flagRowInfo.data + col / 8;
+                mask = 1 << (col % 8);
+                if (*src & mask) {
+                    inside = !inside;
+                }
+                *src &= ~mask;
+                if (inside) {
+                    FCTX_STAT(fctx, pixels_solid, 1);
 #ifdef PBL_COLOR
-                *dest = color;
+                    *dest = color;
 #else
-                *dest = (color & mask) | (*dest & ~mask);
+                    *dest = (color & mask) | (*dest & ~mask);
 #endif
+                }
             }
         }
-        if (col < flagRowInfo.max_x) {
+        if (col <= flagRowInfo.max_x) {
             src = flagRowInfo.data + col / 8;
             mask = 1 << (col % 8);
             *src &= ~mask;
         }
+        if (fctx->bands) {
+            // Flags outside of a round display row are not resolved, and the
+            // band row is reused for other display rows.
+            memset(flagRowInfo.data, 0, gbitmap_get_bytes_per_row(fctx->flag_buffer));
+        }
     }
+}
+
+void fctx_end_fill_bw(FContext* fctx) {
 
-    graphics_release_frame_buffer(fctx->gctx, fb);
+    int16_t rowMin = FIXED_TO_INT(fctx->extent_min.y);
+    int16_t rowMax = FIXED_TO_INT(fctx->extent_max.y);
+
+    if (rowMin < 0) rowMin = 0;
+    if (rowMax >= fctx->flag_bounds.size.h) rowMax = fctx->flag_bounds.size.h - 1;
 
+    FCTX_STAT_END_PHASE(fctx, plot_time);
+    FCTX_STAT(fctx, fills, 1);
+    GBitmap* fb = fctx_capture_target(fctx);
+    fctx_resolve_rows_bw(fctx, fb, rowMin, rowMax);
+    fctx_release_target(fctx, fb);
+    FCTX_STAT_END_PHASE(fctx, resolve_time);
 }
 
 // --------------------------------------------------------------------------
 // AA - anti-aliased drawing with 8 bit-per-pixel flag buffer.
 // --------------------------------------------------------------------------
 
-#ifdef PBL_COLOR
-
 #define SUBPIXEL_COUNT 8
 #define SUBPIXEL_SHIFT 3
 
-#define FIXED_POINT_SHIFT_AA 1
-#define FIXED_POINT_SCALE_AA 2
+#define FIXED_POINT_SHIFT_AA (FIXED_POINT_SHIFT - SUBPIXEL_SHIFT)
+#define FIXED_POINT_SCALE_AA (1 << FIXED_POINT_SHIFT_AA)
 #define INT_TO_FIXED_AA(a) ((a) * FIXED_POINT_SCALE)
 #define FIXED_TO_INT_AA(a) ((a) / FIXED_POINT_SCALE)
 #define FIXED_MULTIPLY_AA(a, b) (((a) * (b)) / FIXED_POINT_SCALE_AA)
@@ -326,17 +615,18 @@ int32_t fceil_aa(fixed_t value) {
  * FPoint is at a scale factor of 16.  The anti-aliased scan conversion needs
  * to address 8x8 subpixels, so if we treat the FPoint coordinates as having
  * a scale factor of 2, then we should scan in sub-pixel coordinates, with
- * sub-sub-pixel correct endpoints!  Fukn shweet.
+ * sub-sub-pixel correct endpoints!  Fukn shweet.  (With a larger
+ * FIXED_POINT_SHIFT, the factor grows to match.)
  */
 void edge_init_aa(Edge* e, FPoint* top, FPoint* bottom) {
-    static const int32_t F = 2;
+    static const int32_t F = FIXED_POINT_SCALE_AA;
     e->y = fceil_aa(top->y);
     int32_t yEnd = fceil_aa(bottom->y);
     e->height = yEnd - e->y;
     if (e->height)    {
-        int32_t dN = bottom->y - top->y;
-        int32_t dM = bottom->x - top->x;
-        int32_t initialNumerator = dM * F * e->y - dM * top->y +
+        fixed_wide_t dN = bottom->y - top->y;
+        fixed_wide_t dM = bottom->x - top->x;
+        fixed_wide_t initialNumerator = dM * F * e->y - dM * top->y +
         dN * top->x - 1 + dN * F;
         floorDivMod(initialNumerator, dN*F, &e->x, &e->errorTerm);
         floorDivMod(dM*F, dN*F, &e->xStep, &e->numerator);
@@ -344,28 +634,49 @@ void edge_init_aa(Edge* e, FPoint* top, FPoint* bottom) {
     }
 }
 
-void fctx_init_context_aa(FContext* fctx, GContext* gctx) {
+static bool fctx_init_context_aa(FContext* fctx, GBitmap* target, int16_t rows) {
 
-    GBitmap* frameBuffer = graphics_capture_frame_buffer(gctx);
-    if (frameBuffer) {
-        GBitmapFormat format = gbitmap_get_format(frameBuffer);
-        fctx->flag_bounds = gbitmap_get_bounds(frameBuffer);
-        graphics_release_frame_buffer(gctx, frameBuffer);
-        fctx->gctx = gctx;
-        fctx->flag_buffer = gbitmap_create_blank(fctx->flag_bounds.size, format);
-        fctx->fill_color = GColorWhite;
-        fctx->subpixel_adjust = -1;
-        fctx->transform_offset = FPointZero;
-        fctx->transform_scale_from = FPointOne;
-        fctx->transform_scale_to = FPointOne;
-    }
+    GRect bounds = gbitmap_get_bounds(target);
+    fctx->flag_bounds = GRect(0, 0, bounds.size.w, rows);
+#ifdef PBL_COLOR
+    // A band is rectangular, even over a circular frame buffer; the resolver
+    // carries the edges that fall outside of each display row.
+    GBitmapFormat format = (rows < bounds.size.h) ? GBitmapFormat8Bit : gbitmap_get_format(target);
+    fctx->flag_buffer = gbitmap_create_blank(fctx->flag_bounds.size, format);
+#else
+    // 1-bit platforms have no 8-bit bitmaps, so each row of flag bytes is
+    // held in a 1-bit row eight times as wide.
+    fctx->flag_buffer = gbitmap_create_blank(GSize(bounds.size.w * 8, rows), GBitmapFormat1Bit);
+#endif
+    fctx->fill_color = GColorWhite;
+    fctx->subpixel_adjust = -(FIXED_POINT_SCALE >> 4);
+    fctx->transform_offset = FPointZero;
+    fctx->transform_scale_from = FPointOne;
+    fctx->transform_scale_to = FPointOne;
+#ifdef FCTX_STATS
+    fctx_reset_stats(fctx);
+#endif
+    return CHECK(fctx->flag_buffer);
+}
+
+/* The flag bytes of one row of the flag buffer, and the columns they cover. */
+static inline GBitmapDataRowInfo fctx_flag_row_aa(FContext* fctx, int16_t y) {
+#ifdef PBL_COLOR
+    return gbitmap_get_data_row_info(fctx->flag_buffer, y);
+#else
+    GBitmapDataRowInfo row;
+    row.data = gbitmap_get_data(fctx->flag_buffer) + y * gbitmap_get_bytes_per_row(fctx->flag_buffer);
+    row.min_x = 0;
+    row.max_x = fctx->flag_bounds.size.w - 1;
+    return row;
+#endif
 }
 
 static const int32_t k_sampling_offsets[SUBPIXEL_COUNT] = {
     2, 7, 4, 1, 6, 3, 0, 5 // 1/8ths
 };
 
-void fctx_plot_edge_aa(FContext* fctx, FPoint* a, FPoint* b) {
+FCTX_ALWAYS_INLINE void fctx_plot_edge_aa(FContext* fctx, FPoint* a, FPoint* b) {
 
     Edge edge;
     if (a->y > b->y) {
@@ -374,23 +685,61 @@ void fctx_plot_edge_aa(FContext* fctx, FPoint* a, FPoint* b) {
         edge_init_aa(&edge, a, b);
     }
 
+    FCTX_STAT(fctx, edges_plotted, 1);
+    int32_t max_y = fctx->flag_bounds.size.h * SUBPIXEL_COUNT - 1;
+
+    if (a->x == b->x) {
+        // A vertical edge has no error term to step, and visits each flag
+        // buffer row eight times.  Rows are counted as the DDA loop below
+        // would count them.
+        int32_t y = edge.y;
+        int32_t end = edge.y + edge.height;
+        if (y < 0) {
+            FCTX_STAT(fctx, dda_steps_skipped, ((end < 0) ? end : 0) - y);
+            y = 0;
+        }
+        if (end > max_y + 1) end = max_y + 1;
+        FCTX_STAT(fctx, dda_steps, (end > y) ? end - y : 0);
+        while (y < end) {
+            int32_t pixelY = y / SUBPIXEL_COUNT;
+            int32_t rowEnd = (pixelY + 1) * SUBPIXEL_COUNT;
+            if (rowEnd > end) rowEnd = end;
+            GBitmapDataRowInfo row = fctx_flag_row_aa(fctx, pixelY);
+            for (; y < rowEnd; ++y) {
+                int32_t ySub = y & (SUBPIXEL_COUNT - 1);
+                int32_t pixelX = (edge.x + k_sampling_offsets[ySub]) / SUBPIXEL_COUNT;
+                if (pixelX < row.min_x) {
+                    row.data[row.min_x] ^= 1 << ySub;
+                } else if (pixelX <= row.max_x) {
+                    row.data[pixelX] ^= 1 << ySub;
+                } else {
+                    FCTX_STAT(fctx, dda_steps_wasted, 1);
+                }
+            }
+        }
+        return;
+    }
+
     while (edge.height > 0 && edge.y < 0) {
+        FCTX_STAT(fctx, dda_steps_skipped, 1);
         edge_step(&edge);
     }
 
-    int32_t max_y = fctx->flag_bounds.size.h * SUBPIXEL_COUNT - 1;
     while (edge.height > 0 && edge.y <= max_y) {
+        FCTX_STAT(fctx, dda_steps, 1);
         int32_t ySub = edge.y & (SUBPIXEL_COUNT - 1);
         uint8_t mask = 1 << ySub;
         int32_t pixelX = (edge.x + k_sampling_offsets[ySub]) / SUBPIXEL_COUNT;
         int32_t pixelY = edge.y / SUBPIXEL_COUNT;
-        GBitmapDataRowInfo row = gbitmap_get_data_row_info(fctx->flag_buffer, pixelY);
+        GBitmapDataRowInfo row = fctx_flag_row_aa(fctx, pixelY);
         if (pixelX < row.min_x) {
             uint8_t* p = row.data + row.min_x;
             *p ^= mask;
         } else if (pixelX <= row.max_x) {
             uint8_t* p = row.data + pixelX;
             *p ^= mask;
+        } else {
+            FCTX_STAT(fctx, dda_steps_wasted, 1);
         }
         edge_step(&edge);
     }
@@ -403,7 +752,7 @@ static inline void fctx_plot_point_aa(FContext* fctx, fixed_t x, fixed_t y) {
     int32_t pixelY = y / SUBPIXEL_COUNT;
 
     if (pixelY >= 0 && pixelY < fctx->flag_bounds.size.h) {
-        GBitmapDataRowInfo row = gbitmap_get_data_row_info(fctx->flag_buffer, pixelY);
+        GBitmapDataRowInfo row = fctx_flag_row_aa(fctx, pixelY);
         if (pixelX < row.min_x) {
             uint8_t* p = row.data + row.min_x;
             *p ^= mask;
@@ -429,151 +778,849 @@ static inline int8_t clamp8(int8_t val, int8_t min, int8_t max) {
     return val;
 }
 
-void fctx_end_fill_aa(FContext* fctx) {
+#ifdef PBL_COLOR
 
-    int16_t rowMin = FIXED_TO_INT(fctx->extent_min.y);
-    int16_t rowMax = FIXED_TO_INT(fctx->extent_max.y);
-    int16_t colMin = FIXED_TO_INT(fctx->extent_min.x);
-    int16_t colMax = FIXED_TO_INT(fctx->extent_max.x);
+/*
+ * Resolve one row of the flag buffer through the fill paint, one span per run
+ * of pixels with the same coverage.
+ * @return the column after the last one scanned.
+ */
+static int16_t fctx_paint_row_aa(FContext* fctx, uint8_t* dest, uint8_t* flags, int16_t row, int16_t spanMin, int16_t spanMax) {
+    const FPaint* paint = fctx->fill_paint;
+    uint8_t mask = 0;
+    uint8_t coverage = 0;
+    int16_t start = spanMin;
+    int16_t col;
+    for (col = spanMin; col <= spanMax; ++col) {
+        mask ^= flags[col];
+        flags[col] = 0;
+        uint8_t a = countBits(mask);
+        if (a != coverage) {
+            if (coverage) {
+                FCTX_STAT(fctx, pixels_blended, (coverage < 8) ? col - start : 0);
+                FCTX_STAT(fctx, pixels_solid, (coverage == 8) ? col - start : 0);
+                paint->span(paint, dest, row, start, col - 1, coverage);
+            }
+            coverage = a;
+            start = col;
+        }
+    }
+    if (coverage) {
+        FCTX_STAT(fctx, pixels_blended, (coverage < 8) ? col - start : 0);
+        FCTX_STAT(fctx, pixels_solid, (coverage == 8) ? col - start : 0);
+        paint->span(paint, dest, row, start, col - 1, coverage);
+    }
+    return col;
+}
 
-    if (rowMin < 0) rowMin = 0;
-    if (rowMax >= fctx->flag_bounds.size.h) rowMax = fctx->flag_bounds.size.h - 1;
+uint8_t fctx_blend_over(uint8_t dest, GColor8 s, uint8_t a) {
+    GColor8 d;
+    d.argb = dest;
+    int32_t as = s.a * a;                  // 0 to 24
+    int32_t ad = d.a * (24 - as) / 3;      // 0 to 24
+    int32_t ao = as + ad;
+    if (ao == 0) {
+        return dest;
+    }
+    d.r = (s.r*as + d.r*ad + ao / 2) / ao;
+    d.g = (s.g*as + d.g*ad + ao / 2) / ao;
+    d.b = (s.b*as + d.b*ad + ao / 2) / ao;
+    d.a = (ao + 4) / 8;
+    return d.argb;
+}
+
+static inline uint8_t fctx_blend_under_channel(uint8_t d, uint8_t s, uint8_t bg, uint8_t w) {
+    int16_t v = 8 * d + (s - bg) * w + 4;
+    return (v < 0) ? 0 : (v > 31) ? 3 : v / 8;
+}
+
+/*
+ * Composite a color with coverage w (in eighths of the pixel) behind a pixel
+ * that already holds the background blended with the fills in front of it.
+ * Over a pixel that holds only the background, this is the same as the blend
+ * used by fctx_end_fill.
+ */
+static inline uint8_t fctx_blend_under(uint8_t dest, GColor8 s, GColor8 bg, uint8_t w) {
+    GColor8 d;
+    d.argb = dest;
+    d.r = fctx_blend_under_channel(d.r, s.r, bg.r, w);
+    d.g = fctx_blend_under_channel(d.g, s.g, bg.g, w);
+    d.b = fctx_blend_under_channel(d.b, s.b, bg.b, w);
+    return d.argb;
+}
+
+/*
+ * Resolve one row of the flag buffer behind the fills drawn since
+ * fctx_begin_occlusion.  Each pixel takes its coverage out of what the fills
+ * in front have left, and pixels that they cover fully are skipped.  Runs of
+ * pixels that this fill covers and no earlier fill touches are written solid.
+ * @return the column after the last one scanned.
+ */
+static int16_t fctx_occlude_row_aa(FContext* fctx, uint8_t* dest, uint8_t* flags, int16_t row, int16_t spanMin, int16_t spanMax) {
+    const FPaint* paint = fctx->fill_paint;
+    FOcclusion* occlusion = fctx->occlusion;
+    uint8_t* claimed = occlusion->coverage + row * occlusion->stride;
+    GColor8 bg = occlusion->background;
+    GColor8 s = fctx->fill_color;
+    uint8_t mask = 0;
+    int16_t start = -1;     // the first column of the current solid run
+    int16_t col;
+    for (col = spanMin; col <= spanMax; ++col) {
+        mask ^= flags[col];
+        flags[col] = 0;
+        if (!mask && start < 0) {
+            continue;
+        }
+        uint8_t* cell = claimed + col / 2;
+        uint8_t shift = (col & 1) * 4;
+        uint8_t c = (*cell >> shift) & 0x0f;
+        uint8_t a = (c < 8) ? countBits(mask) : 0;
+        uint8_t w = (c == 0) ? a : (a * (8 - c) + 4) / 8;
+        if (w == 8) {
+            // Only the background is behind, so the blend is a plain write.
+            start = (start < 0) ? col : start;
+            *cell |= 8 << shift;
+            continue;
+        }
+        if (start >= 0) {
+            FCTX_STAT(fctx, pixels_solid, col - start);
+            if (paint) {
+                paint->span(paint, dest, row, start, col - 1, 8);
+            } else {
+                memset(dest + start, s.argb, col - start);
+            }
+            start = -1;
+        }
+        if (!w) {
+            FCTX_STAT(fctx, pixels_occluded, mask ? 1 : 0);
+            continue;
+        }
+        FCTX_STAT(fctx, pixels_blended, 1);
+        if (paint) {
+            occlusion->scratch[col] = bg.argb;
+            paint->span(paint, occlusion->scratch, row, col, col, 8);
+            s.argb = occlusion->scratch[col];
+        }
+        dest[col] = fctx_blend_under(dest[col], s, bg, w);
+        *cell += w << shift;
+    }
+    if (start >= 0) {
+        FCTX_STAT(fctx, pixels_solid, col - start);
+        if (paint) {
+            paint->span(paint, dest, row, start, col - 1, 8);
+        } else {
+            memset(dest + start, s.argb, col - start);
+        }
+    }
+    return col;
+}
 
-    GBitmap* fb = graphics_capture_frame_buffer(fctx->gctx);
+/*
+ * Resolve rows rowMin to rowMax of the target through the flag buffer, whose
+ * first row is at band_top.
+ */
+static void fctx_resolve_rows_aa(FContext* fctx, GBitmap* fb, int16_t rowMin, int16_t rowMax) {
 
+    int16_t colMin = FIXED_TO_INT(fctx->extent_min.x);
+    int16_t colMax = FIXED_TO_INT(fctx->extent_max.x);
     int16_t col, row;
 
     GColor8 d;
     GColor8 s = fctx->fill_color;
+    bool over = fctx->target != NULL;
     for (row = rowMin; row <= rowMax; ++row) {
         GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
-        GBitmapDataRowInfo flagRowInfo = gbitmap_get_data_row_info(fctx->flag_buffer, row);
+        GBitmapDataRowInfo flagRowInfo = gbitmap_get_data_row_info(fctx->flag_buffer, row - fctx->band_top);
         int16_t spanMin = (fbRowInfo.min_x > colMin) ? fbRowInfo.min_x : colMin;
         int16_t spanMax = (fbRowInfo.max_x < colMax) ? fbRowInfo.max_x : colMax;
+        if (flagRowInfo.min_x < fbRowInfo.min_x) {
+            // A rectangular band over a round display: carry the edges to the
+            // left of the display row into the span.
+            uint8_t carry = 0;
+            for (col = flagRowInfo.min_x; col < fbRowInfo.min_x; ++col) {
+                carry ^= flagRowInfo.data[col];
+                flagRowInfo.data[col] = 0;
+            }
+            if (spanMin <= spanMax) {
+                flagRowInfo.data[spanMin] ^= carry;
+            }
+        }
+        if (flagRowInfo.max_x > fbRowInfo.max_x) {
+            memset(flagRowInfo.data + fbRowInfo.max_x + 1, 0, flagRowInfo.max_x - fbRowInfo.max_x);
+        }
         uint8_t* dest = fbRowInfo.data + spanMin;
         uint8_t* src = flagRowInfo.data + spanMin;
-
-        uint8_t mask = 0;
-        for (col = spanMin; col <= spanMax; ++col, ++dest, ++src) {
-
-            mask ^= *src;
-            *src = 0;
-            uint8_t a = clamp8(countBits(mask), 0, 8);
-            if (a) {
-                d.argb = *dest;
-                d.r = (s.r*a + d.r*(8 - a) + 4) / 8;
-                d.g = (s.g*a + d.g*(8 - a) + 4) / 8;
-                d.b = (s.b*a + d.b*(8 - a) + 4) / 8;
-                *dest = d.argb;
+        FCTX_STAT(fctx, rows_scanned, 1);
+        FCTX_STAT(fctx, pixels_scanned, (spanMax >= spanMin) ? spanMax - spanMin + 1 : 0);
+
+        if (fctx->occlusion) {
+            col = fctx_occlude_row_aa(fctx, fbRowInfo.data, flagRowInfo.data, row, spanMin, spanMax);
+            src = flagRowInfo.data + col;
+        } else if (fctx->fill_paint) {
+            col = fctx_paint_row_aa(fctx, fbRowInfo.data, flagRowInfo.data, row, spanMin, spanMax);
+            src = flagRowInfo.data + col;
+#if defined(FCTX_HOST) && !defined(FCTX_STATS)
+        } else if (!over) {
+            int16_t count = (spanMax >= spanMin) ? spanMax - spanMin + 1 : 0;
+            fctx_resolve_span(dest, src, count, s);
+            col = spanMin + count;
+            src += count;
+#endif
+        } else {
+            uint8_t mask = 0;
+            for (col = spanMin; col <= spanMax; ++col, ++dest, ++src) {
+
+                mask ^= *src;
+                *src = 0;
+                uint8_t a = clamp8(countBits(mask), 0, 8);
+                if (a && over) {
+                    FCTX_STAT(fctx, pixels_blended, 1);
+                    *dest = fctx_blend_over(*dest, s, a);
+                } else if (a) {
+                    FCTX_STAT(fctx, pixels_blended, (a < 8) ? 1 : 0);
+                    FCTX_STAT(fctx, pixels_solid, (a == 8) ? 1 : 0);
+                    d.argb = *dest;
+                    d.r = (s.r*a + d.r*(8 - a) + 4) / 8;
+                    d.g = (s.g*a + d.g*(8 - a) + 4) / 8;
+                    d.b = (s.b*a + d.b*(8 - a) + 4) / 8;
+                    *dest = d.argb;
+                }
             }
         }
-        if (col < flagRowInfo.max_x) *src = 0;
+        if (col <= flagRowInfo.max_x) *src = 0;
     }
+}
+
+void fctx_end_fill_aa(FContext* fctx) {
+
+    int16_t rowMin = FIXED_TO_INT(fctx->extent_min.y);
+    int16_t rowMax = FIXED_TO_INT(fctx->extent_max.y);
 
-    graphics_release_frame_buffer(fctx->gctx, fb);
+    if (rowMin < 0) rowMin = 0;
+    if (rowMax >= fctx->flag_bounds.size.h) rowMax = fctx->flag_bounds.size.h - 1;
 
+    FCTX_STAT_END_PHASE(fctx, plot_time);
+    FCTX_STAT(fctx, fills, 1);
+    GBitmap* fb = fctx_capture_target(fctx);
+    fctx_resolve_rows_aa(fctx, fb, rowMin, rowMax);
+    fctx_release_target(fctx, fb);
+    FCTX_STAT_END_PHASE(fctx, resolve_time);
 }
 
-// Initialize for Anti-Aliased rendering.
-fctx_init_context_func   fctx_init_context   = &fctx_init_context_aa;
-fctx_plot_edge_func      fctx_plot_edge      = &fctx_plot_edge_aa;
-fctx_end_fill_func       fctx_end_fill       = &fctx_end_fill_aa;
+static const FContextOps k_aa_ops = {
+    .plot_edge = &fctx_plot_edge_aa,
+    .end_fill = &fctx_end_fill_aa
+};
 
-void fctx_enable_aa(bool enable) {
-    if (enable) {
-        fctx_init_context   = &fctx_init_context_aa;
-        fctx_plot_edge      = &fctx_plot_edge_aa;
-        fctx_end_fill       = &fctx_end_fill_aa;
-    } else {
-        fctx_init_context   = &fctx_init_context_bw;
-        fctx_plot_edge      = &fctx_plot_edge_bw;
-        fctx_end_fill       = &fctx_end_fill_bw;
+bool fctx_init_mask_context(FContext* fctx, GSize size) {
+    fctx->mode = FContextModeAA;
+    fctx->ops = &k_aa_ops;
+    fctx->coarse_curves = false;
+    fctx->gctx = NULL;
+    fctx->target = NULL;
+    fctx->band_top = 0;
+    fctx->bands = NULL;
+    fctx->occlusion = NULL;
+    fctx->flag_bounds = GRect(0, 0, size.w, size.h);
+    fctx->flag_buffer = gbitmap_create_blank(size, GBitmapFormat8Bit);
+    fctx->fill_color = GColorWhite;
+    fctx->fill_paint = NULL;
+    fctx->subpixel_adjust = 0;
+    fctx->transform_offset = FPointZero;
+    fctx->transform_scale_from = FPointOne;
+    fctx->transform_scale_to = FPointOne;
+#ifdef FCTX_STATS
+    fctx_reset_stats(fctx);
+#endif
+    if (!CHECK(fctx->flag_buffer)) {
+        fctx->ops = &k_null_ops;
+        return false;
     }
+    return true;
 }
 
-bool fctx_is_aa_enabled() {
-    return fctx_init_context == &fctx_init_context_aa;
+void fctx_end_fill_mask(FContext* fctx, uint8_t* mask, uint16_t stride) {
+
+    if (!fctx->flag_buffer) {
+        return;
+    }
+
+    FCTX_STAT_END_PHASE(fctx, plot_time);
+    FCTX_STAT(fctx, fills, 1);
+
+    int16_t width = fctx->flag_bounds.size.w;
+    int16_t height = fctx->flag_bounds.size.h;
+    for (int16_t row = 0; row < height; ++row) {
+        uint8_t* src = gbitmap_get_data_row_info(fctx->flag_buffer, row).data;
+        uint8_t* dest = mask + row * stride;
+        uint8_t flags = 0;
+        FCTX_STAT(fctx, rows_scanned, 1);
+        FCTX_STAT(fctx, pixels_scanned, width);
+        for (int16_t col = 0; col < width; ++col) {
+            flags ^= src[col];
+            src[col] = 0;
+            uint8_t a = countBits(flags);
+            if (col & 1) {
+                dest[col / 2] |= a << 4;
+            } else {
+                dest[col / 2] = a;
+            }
+        }
+    }
+
+    FCTX_STAT_END_PHASE(fctx, resolve_time);
 }
 
 #else
 
-// Initialize for Black & White rendering.
-fctx_init_context_func   fctx_init_context   = &fctx_init_context_bw;
-fctx_plot_edge_func      fctx_plot_edge      = &fctx_plot_edge_bw;
-fctx_end_fill_func       fctx_end_fill       = &fctx_end_fill_bw;
+/*
+ * Resolve one row of the flag buffer to 1-bit pixels.  A pixel is set when
+ * its coverage, in sixteenths, is above the dither threshold at its position,
+ * so an edge pixel is set in proportion to its coverage over a 4x4 block.
+ * Runs of set pixels go to the fill paint; a solid fill is written a byte, or
+ * 8 pixels, at a time.
+ * @return the column after the last one scanned.
+ */
+static int16_t fctx_dither_row_aa(FContext* fctx, uint8_t* dest, uint8_t* flags, int16_t row, int16_t spanMin, int16_t spanMax, uint8_t color) {
+    const FPaint* paint = fctx->fill_paint;
+    const uint8_t* threshold = fdither_bayer[row & 3];
+    uint8_t mask = 0;
+    uint8_t bits = 0;       // the pixels set so far in the current byte
+    int16_t start = -1;     // the first column of the current run of set pixels
+    int16_t col;
+    for (col = spanMin; col <= spanMax; ++col) {
+        mask ^= flags[col];
+        flags[col] = 0;
+        uint8_t a = mask ? countBits(mask) : 0;
+        bool set = 2 * a > threshold[col & 3];
+        FCTX_STAT(fctx, pixels_blended, (a && a < 8) ? 1 : 0);
+        FCTX_STAT(fctx, pixels_solid, (a == 8) ? 1 : 0);
+        if (paint) {
+            if (set && start < 0) {
+                start = col;
+            } else if (!set && start >= 0) {
+                paint->span(paint, dest, row, start, col - 1, 8);
+                start = -1;
+            }
+            continue;
+        }
+        bits |= set << (col % 8);
+        if ((col % 8 == 7 || col == spanMax) && bits) {
+            uint8_t* p = dest + col / 8;
+            *p = (color & bits) | (*p & ~bits);
+            bits = 0;
+        }
+    }
+    if (start >= 0) {
+        paint->span(paint, dest, row, start, col - 1, 8);
+    }
+    return col;
+}
 
-#endif
+/*
+ * Resolve rows rowMin to rowMax of the target through the flag buffer, whose
+ * first row is at band_top.
+ */
+static void fctx_resolve_rows_aa(FContext* fctx, GBitmap* fb, int16_t rowMin, int16_t rowMax) {
 
-// --------------------------------------------------------------------------
-// Transformed Drawing
-// --------------------------------------------------------------------------
+    uint8_t color = 0x00;
+    uint8_t gray = 0;
+    if (gcolor_equal(fctx->fill_color, GColorWhite)) {
+        color = 0xff;
+    } else if (!gcolor_equal(fctx->fill_color, GColorBlack)) {
+        gray = 0b01010101;
+    }
 
-static void bezier(FContext* fctx,
-            fixed_t x1, fixed_t y1,
-            fixed_t x2, fixed_t y2,
-            fixed_t x3, fixed_t y3,
-            fixed_t x4, fixed_t y4) {
-    fixed_t x12, y12;
-    fixed_t x34, y34;
-    fixed_t x123, y123;
-    fixed_t x234, y234;
+    int16_t colMin = FIXED_TO_INT(fctx->extent_min.x);
+    int16_t colMax = FIXED_TO_INT(fctx->extent_max.x);
 
-    {
-        fixed_t x23, y23;
+    for (int16_t row = rowMin; row <= rowMax; ++row) {
+        if (gray) {
+            color = (row & 1) ? gray : ~gray;
+        }
+        GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
+        GBitmapDataRowInfo flagRowInfo = fctx_flag_row_aa(fctx, row - fctx->band_top);
+        int16_t spanMin = (fbRowInfo.min_x > colMin) ? fbRowInfo.min_x : colMin;
+        int16_t spanMax = (fbRowInfo.max_x < colMax) ? fbRowInfo.max_x : colMax;
+        FCTX_STAT(fctx, rows_scanned, 1);
+        FCTX_STAT(fctx, pixels_scanned, (spanMax >= spanMin) ? spanMax - spanMin + 1 : 0);
 
-        // Calculate all the mid-points of the line segments
-        x12   = (x1 + x2) / 2;
-        y12   = (y1 + y2) / 2;
-        x23   = (x2 + x3) / 2;
-        y23   = (y2 + y3) / 2;
-        x34   = (x3 + x4) / 2;
-        y34   = (y3 + y4) / 2;
-        x123  = (x12 + x23) / 2;
-        y123  = (y12 + y23) / 2;
-        x234  = (x23 + x34) / 2;
-        y234  = (y23 + y34) / 2;
+        int16_t col = fctx_dither_row_aa(fctx, fbRowInfo.data, flagRowInfo.data, row, spanMin, spanMax, color);
+        if (col <= flagRowInfo.max_x) flagRowInfo.data[col] = 0;
     }
+}
+
+#endif
+
+static FContextMode s_default_mode = PBL_IF_COLOR_ELSE(FContextModeAA, FContextModeBW);
 
-    FPoint a = {x1, y1};
-    FPoint b = {x12, y12};
-    fctx_plot_edge(fctx, &a, &b);
-    a = (FPoint){x123, y123};
-    fctx_plot_edge(fctx, &b, &a);
-    b = (FPoint){x234, y234};
-    fctx_plot_edge(fctx, &a, &b);
-    a = (FPoint){x34, y34};
-    fctx_plot_edge(fctx, &b, &a);
-    b = (FPoint){x4, y4};
-    fctx_plot_edge(fctx, &a, &b);
+void fctx_enable_aa(bool enable) {
+    s_default_mode = enable ? FContextModeAA : FContextModeBW;
 }
 
-void fctx_move_to_func(FContext* fctx, FPoint* params) {
-    fctx->path_cur_point = params[0];
+bool fctx_is_aa_enabled() {
+    return s_default_mode == FContextModeAA;
 }
 
-void fctx_line_to_func(FContext* fctx, FPoint* params) {
-    fctx_plot_edge(fctx, &fctx->path_cur_point, params + 0);
-    fctx->path_cur_point = params[0];
+static bool s_coarse_curves = false;
+
+void fctx_enable_coarse_curves(bool enable) {
+    s_coarse_curves = enable;
 }
 
-void fctx_curve_to_func(FContext* fctx, FPoint* params) {
-    bezier(fctx,
-           fctx->path_cur_point.x, fctx->path_cur_point.y,
-           params[0].x, params[0].y,
-           params[1].x, params[1].y,
-           params[2].x, params[2].y);
-    fctx->path_cur_point = params[2];
+bool fctx_is_coarse_curves_enabled() {
+    return s_coarse_curves;
 }
 
-void fctx_transform_points(FContext* fctx, uint16_t pcount, FPoint* ppoints, FPoint* tpoints, FPoint advance) {
+static const FContextOps k_bw_ops = {
+    .plot_edge = &fctx_plot_edge_bw,
+    .end_fill = &fctx_end_fill_bw
+};
+
+// --------------------------------------------------------------------------
+// Banded drawing - a flag buffer of a few rows, swept down the target.
+// --------------------------------------------------------------------------
+
+typedef struct FBandState {
+    FFlatPath edges;
+    bool failed;
+} FBandState;
+
+typedef void (*fctx_resolve_rows_func)(FContext* fctx, GBitmap* fb, int16_t rowMin, int16_t rowMax);
+
+static bool fflat_path_append_edge(FFlatPath* flat, FPoint* a, FPoint* b);
+static bool fflat_path_reserve(FFlatPath* flat, uint32_t capacity);
+
+static bool fctx_init_bands(FContext* fctx) {
+    fctx->bands = malloc(sizeof(FBandState));
+    if (!CHECK(fctx->bands)) {
+        return false;
+    }
+    fflat_path_init(&fctx->bands->edges);
+    fctx->bands->failed = false;
+    return fflat_path_reserve(&fctx->bands->edges, FCTX_BAND_EDGE_RESERVE);
+}
+
+static void fctx_destroy_bands(FContext* fctx) {
+    fflat_path_destroy(&fctx->bands->edges);
+    free(fctx->bands);
+    fctx->bands = NULL;
+}
+
+static void fctx_plot_edge_band(FContext* fctx, FPoint* a, FPoint* b) {
+    FBandState* bands = fctx->bands;
+    if (!bands->failed && !fflat_path_append_edge(&bands->edges, a, b)) {
+        bands->failed = true;
+    }
+}
+
+/*
+ * Plot the recorded edges that cross each band, moved up by the top of the
+ * band, and resolve the band.  Moving an edge by whole pixels does not change
+ * the rows or columns that the DDA visits, so the result is the same as for
+ * an unbanded flag buffer.
+ */
+FCTX_ALWAYS_INLINE void fctx_end_fill_band(FContext* fctx, fctx_plot_edge_func plot, fctx_resolve_rows_func resolve) {
+
+    FBandState* bands = fctx->bands;
+    FFlatPath* edges = &bands->edges;
+    FCTX_STAT_END_PHASE(fctx, plot_time);
+    FCTX_STAT(fctx, fills, 1);
+
+    GBitmap* fb = NULL;
+    if (bands->failed) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "fctx: out of memory for %d edges", edges->count);
+    } else if (edges->count) {
+        fb = fctx_capture_target(fctx);
+    }
+
+    if (fb) {
+        int16_t height = gbitmap_get_bounds(fb).size.h;
+        int16_t bandHeight = fctx->flag_bounds.size.h;
+        int16_t rowMin = FIXED_TO_INT(edges->min.y);
+        int16_t rowMax = FIXED_TO_INT(edges->max.y);
+        if (rowMin < 0) rowMin = 0;
+        if (rowMax >= height) rowMax = height - 1;
+
+        for (int16_t top = rowMin; top <= rowMax; top += bandHeight) {
+            int16_t bottom = top + bandHeight - 1;
+            fixed_t shift = INT_TO_FIXED(top);
+            fixed_t limit = INT_TO_FIXED(top + bandHeight);
+            fctx->band_top = top;
+
+            FPoint* p = edges->points;
+            FPoint* end = p + edges->count;
+            FPoint* prev = NULL;
+            for (; p < end; ++p) {
+                if (p->x == FFLAT_PATH_BREAK) {
+                    prev = NULL;
+                    continue;
+                }
+                if (prev && (prev->y > shift || p->y > shift) && (prev->y < limit || p->y < limit)) {
+                    FPoint a = FPoint(prev->x, prev->y - shift);
+                    FPoint b = FPoint(p->x, p->y - shift);
+                    plot(fctx, &a, &b);
+                }
+                prev = p;
+            }
+
+            if (bottom > rowMax) {
+                // The edges may have been plotted below the last row that is
+                // resolved, so clear the rest of the band.
+                uint16_t stride = gbitmap_get_bytes_per_row(fctx->flag_buffer);
+                uint8_t* data = gbitmap_get_data(fctx->flag_buffer);
+                resolve(fctx, fb, top, rowMax);
+                memset(data + (rowMax - top + 1) * stride, 0, (bottom - rowMax) * stride);
+            } else {
+                resolve(fctx, fb, top, bottom);
+            }
+        }
+        fctx->band_top = 0;
+        fctx_release_target(fctx, fb);
+    }
+
+    fflat_path_clear(edges);
+    bands->failed = false;
+    FCTX_STAT_END_PHASE(fctx, resolve_time);
+}
+
+static void fctx_end_fill_bw_band(FContext* fctx) {
+    fctx_end_fill_band(fctx, &fctx_plot_edge_bw, &fctx_resolve_rows_bw);
+}
+
+static const FContextOps k_bw_band_ops = {
+    .plot_edge = &fctx_plot_edge_band,
+    .end_fill = &fctx_end_fill_bw_band
+};
+
+static void fctx_end_fill_aa_band(FContext* fctx) {
+    fctx_end_fill_band(fctx, &fctx_plot_edge_aa, &fctx_resolve_rows_aa);
+}
+
+static const FContextOps k_aa_band_ops = {
+    .plot_edge = &fctx_plot_edge_band,
+    .end_fill = &fctx_end_fill_aa_band
+};
+
+// --------------------------------------------------------------------------
+// Initialization
+// --------------------------------------------------------------------------
+
+/*
+ * Put the context in a state where it can be drawn with and deinitialized,
+ * but draws nothing.
+ */
+static void fctx_reset_context(FContext* fctx, FContextMode mode) {
+    fctx->ops = &k_null_ops;
+    fctx->mode = mode;
+    fctx->coarse_curves = s_coarse_curves;
+    fctx->flag_buffer = NULL;
+    fctx->flag_bounds = GRect(0, 0, 0, 0);
+    fctx->band_top = 0;
+    fctx->bands = NULL;
+    fctx->occlusion = NULL;
+    fctx->fill_paint = NULL;
+    fctx->subpixel_adjust = 0;
+    fctx->transform_offset = FPointZero;
+    fctx->transform_scale_from = FPointOne;
+    fctx->transform_scale_to = FPointOne;
+#ifdef FCTX_STATS
+    fctx_reset_stats(fctx);
+#endif
+}
+
+/*
+ * The number of flag buffer rows for a context over a target of the given
+ * height.  On 1-bit platforms an AA flag buffer has a byte per pixel, eight
+ * times the frame buffer, so AA contexts there are always banded.
+ */
+static int16_t fctx_flag_rows(FContextMode mode, int16_t height, int16_t band_height) {
+    if (band_height > 0 && band_height < height) {
+        return band_height;
+    }
+#ifdef PBL_BW
+    if (mode == FContextModeAA && FCTX_DITHER_BAND_HEIGHT < height) {
+        return FCTX_DITHER_BAND_HEIGHT;
+    }
+#endif
+    return height;
+}
+
+static bool fctx_init_context_target(FContext* fctx, GBitmap* target, FContextMode mode, int16_t band_height) {
+
+    int16_t height = gbitmap_get_bounds(target).size.h;
+    int16_t rows = fctx_flag_rows(mode, height, band_height);
+    bool banded = rows < height;
+    bool ok;
+    if (mode == FContextModeAA) {
+        fctx->mode = FContextModeAA;
+#ifdef PBL_COLOR
+        fctx->ops = banded ? &k_aa_band_ops : &k_aa_ops;
+#else
+        fctx->ops = &k_aa_band_ops;
+#endif
+        ok = fctx_init_context_aa(fctx, target, rows);
+    } else {
+        fctx->mode = FContextModeBW;
+        fctx->ops = banded ? &k_bw_band_ops : &k_bw_ops;
+        ok = fctx_init_context_bw(fctx, target, rows);
+    }
+
+    if (ok && banded) {
+        ok = fctx_init_bands(fctx);
+    }
+    if (!ok) {
+        if (fctx->flag_buffer) {
+            gbitmap_destroy(fctx->flag_buffer);
+            fctx->flag_buffer = NULL;
+        }
+        if (fctx->bands) {
+            fctx_destroy_bands(fctx);
+        }
+        fctx->ops = &k_null_ops;
+    }
+    return ok;
+}
+
+bool fctx_init_context_banded(FContext* fctx, GContext* gctx, FContextMode mode, int16_t band_height) {
+    fctx->gctx = gctx;
+    fctx->target = NULL;
+    fctx_reset_context(fctx, mode);
+    GBitmap* frameBuffer = graphics_capture_frame_buffer(gctx);
+    if (!CHECK(frameBuffer)) {
+        return false;
+    }
+    bool ok = fctx_init_context_target(fctx, frameBuffer, mode, band_height);
+    graphics_release_frame_buffer(gctx, frameBuffer);
+    return ok;
+}
+
+bool fctx_init_context_mode(FContext* fctx, GContext* gctx, FContextMode mode) {
+    return fctx_init_context_banded(fctx, gctx, mode, 0);
+}
+
+bool fctx_init_context_bitmap(FContext* fctx, GBitmap* target, FContextMode mode) {
+    fctx->gctx = NULL;
+    fctx->target = target;
+    fctx_reset_context(fctx, mode);
+    return fctx_init_context_target(fctx, target, mode, 0);
+}
+
+bool fctx_init_context(FContext* fctx, GContext* gctx) {
+    return fctx_init_context_mode(fctx, gctx, s_default_mode);
+}
+
+GBitmap* fctx_capture_target(FContext* fctx) {
+    if (fctx->target) {
+        return fctx->target;
+    }
+    FCTX_STAT(fctx, framebuffer_captures, 1);
+    return graphics_capture_frame_buffer(fctx->gctx);
+}
+
+void fctx_release_target(FContext* fctx, GBitmap* target) {
+    if (!fctx->target) {
+        graphics_release_frame_buffer(fctx->gctx, target);
+    }
+}
+
+/*
+ * Heap bytes beyond the pixels of a flag buffer: the GBitmap object that
+ * gbitmap_create_blank allocates with them, and the allocator's block
+ * headers.  The firmware's GBitmap is private, so this is a generous guess.
+ */
+#define FCTX_BITMAP_OVERHEAD 48
+
+/* The allocator's header for each heap block. */
+#define FCTX_HEAP_BLOCK_OVERHEAD 8
+
+size_t fctx_memory_required_bitmap(GBitmap* target, FContextMode mode, int16_t band_height) {
+
+    GRect bounds = gbitmap_get_bounds(target);
+    int16_t rows = fctx_flag_rows(mode, bounds.size.h, band_height);
+    bool banded = rows < bounds.size.h;
+    size_t bytes;
+#ifdef PBL_COLOR
+    if (mode == FContextModeAA) {
+        if (!banded && gbitmap_get_format(target) == GBitmapFormat8BitCircular) {
+            bytes = 0;
+            for (int16_t row = 0; row < rows; ++row) {
+                GBitmapDataRowInfo info = gbitmap_get_data_row_info(target, row);
+                bytes += info.max_x - info.min_x + 1;
+            }
+        } else {
+            bytes = bounds.size.w * rows;
+        }
+    } else
+#else
+    if (mode == FContextModeAA) {
+        // A byte per pixel, in 1-bit rows padded to a multiple of 4 bytes.
+        bytes = (bounds.size.w + 3) / 4 * 4 * rows;
+    } else
+#endif
+    {
+        // 1-bit rows are padded to a multiple of 4 bytes.
+        bytes = (bounds.size.w + 31) / 32 * 4 * rows;
+    }
+    bytes += FCTX_BITMAP_OVERHEAD;
+    if (banded) {
+        // The band state and its edge list are two blocks.
+        bytes += sizeof(FBandState) + FCTX_BAND_EDGE_RESERVE * sizeof(FPoint) + 2 * FCTX_HEAP_BLOCK_OVERHEAD;
+    }
+    return bytes;
+}
+
+size_t fctx_memory_required(GContext* gctx, FContextMode mode, int16_t band_height) {
+    GBitmap* frameBuffer = graphics_capture_frame_buffer(gctx);
+    if (!CHECK(frameBuffer)) {
+        return 0;
+    }
+    size_t bytes = fctx_memory_required_bitmap(frameBuffer, mode, band_height);
+    graphics_release_frame_buffer(gctx, frameBuffer);
+    return bytes;
+}
+
+bool fctx_init_context_auto(FContext* fctx, GContext* gctx, size_t reserve) {
+
+    GBitmap* frameBuffer = graphics_capture_frame_buffer(gctx);
+    if (!CHECK(frameBuffer)) {
+        fctx->gctx = NULL;
+        fctx->target = NULL;
+        fctx_reset_context(fctx, s_default_mode);
+        return false;
+    }
+    int16_t height = gbitmap_get_bounds(frameBuffer).size.h;
+    graphics_release_frame_buffer(gctx, frameBuffer);
+
+    FContextMode modes[2] = { s_default_mode, FContextModeBW };
+    uint8_t modeCount = (s_default_mode == FContextModeBW) ? 1 : 2;
+    for (uint8_t k = 0; k < modeCount; ++k) {
+        for (int16_t band = 0; band == 0 || band >= FCTX_MIN_BAND_HEIGHT; band = band ? band / 2 : height / 2) {
+            size_t required = fctx_memory_required(gctx, modes[k], band) + reserve;
+            if (required <= heap_bytes_free() && fctx_init_context_banded(fctx, gctx, modes[k], band)) {
+                if (k > 0 || band > 0) {
+                    APP_LOG(APP_LOG_LEVEL_WARNING, "fctx: low memory, using mode %d in %d row bands", modes[k], band);
+                }
+                return true;
+            }
+        }
+    }
+
+    APP_LOG(APP_LOG_LEVEL_ERROR, "fctx: not enough memory for any context");
+    fctx->gctx = gctx;
+    fctx->target = NULL;
+    fctx_reset_context(fctx, s_default_mode);
+    return false;
+}
+
+void fctx_plot_edge(FContext* fctx, FPoint* a, FPoint* b) {
+    fctx->ops->plot_edge(fctx, a, b);
+}
+
+void fctx_end_fill(FContext* fctx) {
+    fctx->ops->end_fill(fctx);
+}
+
+// --------------------------------------------------------------------------
+// Layers
+// --------------------------------------------------------------------------
+
+#ifdef PBL_COLOR
+
+static void fctx_draw_layer_row(uint8_t* dest, const uint8_t* src, int16_t count) {
+    int16_t k = 0;
+    while (k < count) {
+        // Skip clear and copy opaque pixels four at a time.
+        if (k + 4 <= count) {
+            uint32_t alpha;
+            memcpy(&alpha, src + k, sizeof alpha);
+            alpha &= 0xc0c0c0c0;
+            if (alpha == 0) {
+                k += 4;
+                continue;
+            }
+            if (alpha == 0xc0c0c0c0) {
+                memcpy(dest + k, src + k, 4);
+                k += 4;
+                continue;
+            }
+        }
+        GColor8 c;
+        c.argb = src[k];
+        if (c.a == 3) {
+            dest[k] = c.argb;
+        } else if (c.a) {
+            dest[k] = fctx_blend_over(dest[k], c, 8);
+        }
+        ++k;
+    }
+}
+
+#else
+
+static void fctx_draw_layer_row(uint8_t* dest, const uint8_t* src, int16_t dest_x, int16_t src_x, int16_t count) {
+    if (dest_x % 8 == 0 && src_x % 8 == 0) {
+        memcpy(dest + dest_x / 8, src + src_x / 8, count / 8);
+        dest_x += count & ~7;
+        src_x += count & ~7;
+        count &= 7;
+    }
+    for (; count > 0; --count, ++dest_x, ++src_x) {
+        uint8_t mask = 1 << (dest_x % 8);
+        if (src[src_x / 8] & (1 << (src_x % 8))) {
+            dest[dest_x / 8] |= mask;
+        } else {
+            dest[dest_x / 8] &= ~mask;
+        }
+    }
+}
+
+#endif
+
+void fctx_draw_layer(FContext* fctx, GBitmap* layer, GPoint origin) {
+
+    GBitmap* fb = fctx_capture_target(fctx);
+    if (!fb) {
+        return;
+    }
+    GRect fbBounds = gbitmap_get_bounds(fb);
+    GSize size = gbitmap_get_bounds(layer).size;
+    for (int16_t j = 0; j < size.h; ++j) {
+        int16_t row = origin.y + j;
+        if (row < 0 || row >= fbBounds.size.h) {
+            continue;
+        }
+        GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
+        GBitmapDataRowInfo layerRowInfo = gbitmap_get_data_row_info(layer, j);
+        int16_t x0 = origin.x + layerRowInfo.min_x;
+        int16_t x1 = origin.x + layerRowInfo.max_x;
+        if (x0 < fbRowInfo.min_x) x0 = fbRowInfo.min_x;
+        if (x1 > fbRowInfo.max_x) x1 = fbRowInfo.max_x;
+        if (x1 < x0) {
+            continue;
+        }
+#ifdef PBL_COLOR
+        fctx_draw_layer_row(fbRowInfo.data + x0, layerRowInfo.data + x0 - origin.x, x1 - x0 + 1);
+#else
+        fctx_draw_layer_row(fbRowInfo.data, layerRowInfo.data, x0, x0 - origin.x, x1 - x0 + 1);
+#endif
+    }
+    fctx_release_target(fctx, fb);
+}
+
+// --------------------------------------------------------------------------
+// Transformed Drawing
+// --------------------------------------------------------------------------
+
+void fctx_transform_points(FContext* fctx, uint16_t pcount, FPoint* ppoints, FPoint* tpoints, FPoint advance) {
 
     /* transform the parameters */
     FPoint* src = ppoints;
     FPoint* dst = tpoints;
     FPoint* end = dst + pcount;
     while (dst != end) {
-        dst->x = (src->x + advance.x) * fctx->transform_scale_to.x / fctx->transform_scale_from.x;
-        dst->y = (src->y + advance.y) * fctx->transform_scale_to.y / fctx->transform_scale_from.y;
+        dst->x = (fixed_wide_t)(src->x + advance.x) * fctx->transform_scale_to.x / fctx->transform_scale_from.x;
+        dst->y = (fixed_wide_t)(src->y + advance.y) * fctx->transform_scale_to.y / fctx->transform_scale_from.y;
         dst->x += fctx->transform_offset.x + fctx->subpixel_adjust;
         dst->y += fctx->transform_offset.y + fctx->subpixel_adjust;
 
@@ -588,125 +1635,431 @@ void fctx_transform_points(FContext* fctx, uint16_t pcount, FPoint* ppoints, FPo
     }
 }
 
-typedef void (*fctx_draw_cmd_func)(FContext* fctx, FPoint* params);
+// --------------------------------------------------------------------------
+// Path data decoding
+// --------------------------------------------------------------------------
+
+/* The number of parameters of a command, or -1 if the code is invalid. */
+static inline int8_t fctx_path_param_count(uint16_t code) {
+    switch (code) {
+        case 'Z': return 0;
+        case 'H':
+        case 'V': return 1;
+        case 'M':
+        case 'L':
+        case 'T': return 2;
+        case 'S':
+        case 'Q': return 4;
+        case 'C': return 6;
+        default: return -1;
+    }
+}
+
+void fctx_path_cursor_init(FPathCursor* cursor, const void* path_data, uint16_t length) {
+    cursor->data = path_data;
+    cursor->end = cursor->data + length;
+    cursor->packed = length > 0 && cursor->data[0] == FCTX_PACKED_PATH_MAGIC;
+    if (cursor->packed) {
+        ++cursor->data;
+    }
+    cursor->code = 0;
+    cursor->repeat = 0;
+    cursor->x = cursor->y = 0;
+    cursor->init_x = cursor->init_y = 0;
+}
+
+FCTX_ALWAYS_INLINE fixed16_t fctx_path_read_delta(FPathCursor* cursor, fixed16_t prev) {
+    uint32_t u = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+        b = *cursor->data++;
+        u |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while ((b & 0x80) && cursor->data < cursor->end);
+    return (fixed16_t)(prev + (fixed16_t)((u >> 1) ^ -(u & 1)));
+}
+
+FCTX_ALWAYS_INLINE char fctx_path_next(FPathCursor* cursor, fixed16_t* params) {
+
+    if (!cursor->packed) {
+        if (cursor->data >= cursor->end) {
+            return 0;
+        }
+        FPathDrawCommand* cmd = (FPathDrawCommand*)cursor->data;
+        int8_t count = fctx_path_param_count(cmd->code);
+        if (count < 0) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "invalid draw command %d", cmd->code);
+            return 0;
+        }
+        memcpy(params, cmd->params, count * sizeof(fixed16_t));
+        cursor->data = (const uint8_t*)(cmd->params + count);
+        return cmd->code;
+    }
+
+    if (cursor->repeat == 0) {
+        if (cursor->data >= cursor->end) {
+            return 0;
+        }
+        uint8_t b = *cursor->data++;
+        if ((b & 0x0f) >= sizeof(FCTX_PACKED_PATH_CODES) - 1) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "invalid packed draw command %d", b);
+            return 0;
+        }
+        cursor->code = FCTX_PACKED_PATH_CODES[b & 0x0f];
+        cursor->repeat = (b >> 4) + 1;
+    }
+    --cursor->repeat;
+
+    char code = cursor->code;
+    if (code == 'Z') {
+        cursor->x = cursor->init_x;
+        cursor->y = cursor->init_y;
+    } else if (code == 'H') {
+        params[0] = cursor->x = fctx_path_read_delta(cursor, cursor->x);
+    } else if (code == 'V') {
+        params[0] = cursor->y = fctx_path_read_delta(cursor, cursor->y);
+    } else {
+        int8_t count = fctx_path_param_count(code);
+        for (int8_t k = 0; k < count; k += 2) {
+            params[k] = cursor->x = fctx_path_read_delta(cursor, cursor->x);
+            params[k + 1] = cursor->y = fctx_path_read_delta(cursor, cursor->y);
+        }
+        if (code == 'M') {
+            cursor->init_x = cursor->x;
+            cursor->init_y = cursor->y;
+        }
+    }
+    return code;
+}
+
+char fctx_path_cursor_next(FPathCursor* cursor, fixed16_t* params) {
+    return fctx_path_next(cursor, params);
+}
+
+bool fctx_path_validate(const void* path_data, uint16_t length) {
+    const uint8_t* data = path_data;
+    const uint8_t* end = data + length;
+    if (length == 0 || data[0] != FCTX_PACKED_PATH_MAGIC) {
+        while (data < end) {
+            size_t left = end - data;
+            int8_t count = (left >= sizeof(FPathDrawCommand))
+                         ? fctx_path_param_count(((const FPathDrawCommand*)data)->code) : -1;
+            if (count < 0 || left < sizeof(FPathDrawCommand) + count * sizeof(fixed16_t)) {
+                return false;
+            }
+            data += sizeof(FPathDrawCommand) + count * sizeof(fixed16_t);
+        }
+        return true;
+    }
+
+    ++data;
+    while (data < end) {
+        uint8_t b = *data++;
+        if ((b & 0x0f) >= sizeof(FCTX_PACKED_PATH_CODES) - 1) {
+            return false;
+        }
+        int8_t count = fctx_path_param_count(FCTX_PACKED_PATH_CODES[b & 0x0f]);
+        for (int16_t k = ((b >> 4) + 1) * count; k > 0; --k) {
+            // Each parameter ends with a byte that has the top bit clear.
+            do {
+                if (data >= end) {
+                    return false;
+                }
+            } while (*data++ & 0x80);
+        }
+    }
+    return true;
+}
+
+// Generate a path interpreter for each rendering mode, with the edge plotter
+// inlined, and a generic one that dispatches through the context's ops.
+
+#define FCTX_MODE_FUNC(name) name##_bw
+#define FCTX_PLOT_EDGE(fctx, a, b) fctx_plot_edge_bw(fctx, a, b)
+#include "fctx_draw_commands.inc"
+#undef FCTX_MODE_FUNC
+#undef FCTX_PLOT_EDGE
+
+#ifdef PBL_COLOR
+#define FCTX_MODE_FUNC(name) name##_aa
+#define FCTX_PLOT_EDGE(fctx, a, b) fctx_plot_edge_aa(fctx, a, b)
+#include "fctx_draw_commands.inc"
+#undef FCTX_MODE_FUNC
+#undef FCTX_PLOT_EDGE
+#endif
+
+#define FCTX_MODE_FUNC(name) name##_ops
+#define FCTX_PLOT_EDGE(fctx, a, b) fctx->ops->plot_edge(fctx, a, b)
+#include "fctx_draw_commands.inc"
+#undef FCTX_MODE_FUNC
+#undef FCTX_PLOT_EDGE
 
 void fctx_draw_commands(FContext* fctx, FPoint advance, void* path_data, uint16_t length) {
+#ifdef PBL_COLOR
+    if (fctx->ops == &k_aa_ops) {
+        fctx_draw_commands_aa(fctx, advance, path_data, length);
+        return;
+    }
+#endif
+    if (fctx->ops == &k_bw_ops) {
+        fctx_draw_commands_bw(fctx, advance, path_data, length);
+    } else {
+        fctx_draw_commands_ops(fctx, advance, path_data, length);
+    }
+}
 
-    fctx_draw_cmd_func func;
-    FPoint initpt = FPointZero;
-    FPoint curpt = FPointZero;
-    FPoint ctrlpt = FPointZero;
-    FPoint tpoints[3];
-
-    void* path_data_end = path_data + length;
-    while (path_data < path_data_end) {
-        {
-            /* choose the draw function and parameter count. */
-            FPathDrawCommand* cmd = (FPathDrawCommand*)path_data;
-            fixed16_t* param = (fixed16_t*)&cmd->params;
-            FPoint ppoints[3];
-
-            switch (cmd->code) {
-                case 'M': // "moveto"
-                    func = fctx_move_to_func;
-                    ppoints[0].x = *param++;
-                    ppoints[0].y = *param++;
-                    curpt = ppoints[0];
-                    initpt = curpt;
-                    fctx_transform_points(fctx, 1, ppoints, tpoints, advance);
-                    break;
-                case 'Z': // "closepath"
-                    func = fctx_line_to_func;
-                    ppoints[0] = initpt;
-                    curpt = ppoints[0];
-                    fctx_transform_points(fctx, 1, ppoints, tpoints, advance);
-                    break;
-                case 'L': // "lineto"
-                    func = fctx_line_to_func;
-                    ppoints[0].x = *param++;
-                    ppoints[0].y = *param++;
-                    curpt = ppoints[0];
-                    fctx_transform_points(fctx, 1, ppoints, tpoints, advance);
-                    fctx_line_to_func(fctx, tpoints);
-                    break;
-                case 'H': // "horizontal lineto"
-                    func = fctx_line_to_func;
-                    ppoints[0].x = *param++;
-                    ppoints[0].y = curpt.y;
-                    curpt.x = ppoints[0].x;
-                    fctx_transform_points(fctx, 1, ppoints, tpoints, advance);
-                    break;
-                case 'V': // "vertical lineto"
-                    func = fctx_line_to_func;
-                    ppoints[0].x = curpt.x;
-                    ppoints[0].y = *param++;
-                    curpt.y = ppoints[0].y;
-                    fctx_transform_points(fctx, 1, ppoints, tpoints, advance);
-                    fctx_line_to_func(fctx, tpoints);
-                    break;
-                case 'C': // "cubic bezier curveto"
-                    func = fctx_curve_to_func;
-                    ppoints[0].x = *param++;
-                    ppoints[0].y = *param++;
-                    ppoints[1].x = *param++;
-                    ppoints[1].y = *param++;
-                    ppoints[2].x = *param++;
-                    ppoints[2].y = *param++;
-                    ctrlpt = ppoints[1];
-                    curpt = ppoints[2];
-                    fctx_transform_points(fctx, 3, ppoints, tpoints, advance);
-                    break;
-                case 'S': // "smooth cubic bezier curveto"
-                    func = fctx_curve_to_func;
-                    ppoints[1].x = *param++;
-                    ppoints[1].y = *param++;
-                    ppoints[2].x = *param++;
-                    ppoints[2].y = *param++;
-                    ppoints[0].x = curpt.x - ctrlpt.x + curpt.x;
-                    ppoints[0].y = curpt.y - ctrlpt.y + curpt.y;
-                    ctrlpt = ppoints[1];
-                    curpt = ppoints[2];
-                    fctx_transform_points(fctx, 3, ppoints, tpoints, advance);
-                    break;
-                case 'Q': // "quadratic bezier curveto"
-                    func = fctx_curve_to_func;
-                    ctrlpt.x = *param++;
-                    ctrlpt.y = *param++;
-                    ppoints[2].x = *param++;
-                    ppoints[2].y = *param++;
-                    ppoints[0].x = (curpt.x      + 2 * ctrlpt.x) / 3;
-                    ppoints[0].y = (curpt.y      + 2 * ctrlpt.y) / 3;
-                    ppoints[1].x = (ppoints[2].x + 2 * ctrlpt.x) / 3;
-                    ppoints[1].y = (ppoints[2].y + 2 * ctrlpt.y) / 3;
-                    curpt = ppoints[2];
-                    fctx_transform_points(fctx, 3, ppoints, tpoints, advance);
-                    break;
-                case 'T': // "smooth quadratic bezier curveto"
-                    func = fctx_curve_to_func;
-                    ctrlpt.x = curpt.x - ctrlpt.x + curpt.x;
-                    ctrlpt.y = curpt.y - ctrlpt.y + curpt.y;
-                    ppoints[2].x = *param++;
-                    ppoints[2].y = *param++;
-                    ppoints[0].x = (curpt.x      + 2 * ctrlpt.x) / 3;
-                    ppoints[0].y = (curpt.y      + 2 * ctrlpt.y) / 3;
-                    ppoints[1].x = (ppoints[2].x + 2 * ctrlpt.x) / 3;
-                    ppoints[1].y = (ppoints[2].y + 2 * ctrlpt.y) / 3;
-                    curpt = ppoints[2];
-                    fctx_transform_points(fctx, 3, ppoints, tpoints, advance);
-                    break;
-                default:
-                    APP_LOG(APP_LOG_LEVEL_ERROR, "invalid draw command %d", cmd->code);
-                    return;
+// --------------------------------------------------------------------------
+// Rectangles
+// --------------------------------------------------------------------------
+
+#ifdef PBL_COLOR
+
+/*
+ * Blend columns from to to-1 of one row, counting the sub-rows whose span
+ * [lo, hi) covers each column.
+ */
+static void fctx_fill_rect_partial_aa(FContext* fctx, uint8_t* dest, GColor8 s,
+            int16_t* lo, int16_t* hi, int16_t n, int16_t from, int16_t to) {
+    GColor8 d;
+    for (int16_t col = from; col < to; ++col) {
+        uint8_t a = 0;
+        for (int16_t i = 0; i < n; ++i) {
+            a += (lo[i] <= col && col < hi[i]) ? 1 : 0;
+        }
+        if (a) {
+            FCTX_STAT(fctx, pixels_blended, (a < 8) ? 1 : 0);
+            FCTX_STAT(fctx, pixels_solid, (a == 8) ? 1 : 0);
+            d.argb = dest[col];
+            d.r = (s.r*a + d.r*(8 - a) + 4) / 8;
+            d.g = (s.g*a + d.g*(8 - a) + 4) / 8;
+            d.b = (s.b*a + d.b*(8 - a) + 4) / 8;
+            dest[col] = d.argb;
+        }
+    }
+}
+
+/*
+ * Resolve a rectangle straight from its corners, without the flag buffer.
+ * Each sub-row's span is found where the edge plotter would toggle it and
+ * clipped the way fctx_resolve_rows_aa would clip it, so the result is the
+ * same as plotting the two vertical edges and calling fctx_end_fill.  Rows
+ * that all eight sub-rows cross fully are written as a solid span.
+ */
+static void fctx_fill_rect_aa(FContext* fctx, FPoint* a, FPoint* b) {
+
+    FPoint tl = { (a->x < b->x) ? a->x : b->x, (a->y < b->y) ? a->y : b->y };
+    FPoint br = { (a->x < b->x) ? b->x : a->x, (a->y < b->y) ? b->y : a->y };
+    FPoint bl = { tl.x, br.y };
+    FPoint tr = { br.x, tl.y };
+
+    FCTX_STAT_END_PHASE(fctx, plot_time);
+    FCTX_STAT(fctx, fills, 1);
+
+    int32_t yMin = fceil_aa(tl.y);
+    int32_t yMax = fceil_aa(br.y);
+    int32_t yLimit = fctx->flag_bounds.size.h * SUBPIXEL_COUNT;
+    if (yMin < 0) yMin = 0;
+    if (yMax > yLimit) yMax = yLimit;
+    if (yMin >= yMax) {
+        FCTX_STAT_END_PHASE(fctx, resolve_time);
+        return;
+    }
+
+    Edge left, right;
+    edge_init_aa(&left, &tl, &bl);
+    edge_init_aa(&right, &tr, &br);
+
+    int16_t colMin = FIXED_TO_INT(fctx->extent_min.x);
+    int16_t colMax = FIXED_TO_INT(fctx->extent_max.x);
+    GColor8 s = fctx->fill_color;
+    uint8_t solid = s.argb & 0x3f;
+
+    GBitmap* fb = fctx_capture_target(fctx);
+    for (int16_t row = yMin / SUBPIXEL_COUNT; row <= (yMax - 1) / SUBPIXEL_COUNT; ++row) {
+        GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
+        int16_t spanMin = (fbRowInfo.min_x > colMin) ? fbRowInfo.min_x : colMin;
+        int16_t spanMax = (fbRowInfo.max_x < colMax) ? fbRowInfo.max_x : colMax;
+        FCTX_STAT(fctx, rows_scanned, 1);
+        if (spanMin > spanMax) {
+            continue;
+        }
+        FCTX_STAT(fctx, pixels_scanned, spanMax - spanMin + 1);
+
+        int16_t lo[SUBPIXEL_COUNT];
+        int16_t hi[SUBPIXEL_COUNT];
+        int16_t n = 0;
+        int16_t minLo = spanMax + 1, maxLo = spanMin;
+        int16_t minHi = spanMax + 1, maxHi = spanMin;
+        for (int32_t ySub = 0; ySub < SUBPIXEL_COUNT; ++ySub) {
+            int32_t y = row * SUBPIXEL_COUNT + ySub;
+            if (y < yMin || y >= yMax) {
+                continue;
             }
+            int32_t l = (left.x + k_sampling_offsets[ySub]) / SUBPIXEL_COUNT;
+            int32_t r = (right.x + k_sampling_offsets[ySub]) / SUBPIXEL_COUNT;
+            if (l < spanMin) l = spanMin;
+            if (r < fbRowInfo.min_x) r = fbRowInfo.min_x;
+            if (r > spanMax) r = spanMax + 1;
+            if (l >= r) {
+                continue;
+            }
+            lo[n] = l;
+            hi[n] = r;
+            ++n;
+            if (l < minLo) minLo = l;
+            if (l > maxLo) maxLo = l;
+            if (r < minHi) minHi = r;
+            if (r > maxHi) maxHi = r;
+        }
 
-            /* advance to next draw command */
-            path_data = (void*)param;
+        uint8_t* dest = fbRowInfo.data;
+        if (n == SUBPIXEL_COUNT && maxLo < minHi) {
+            fctx_fill_rect_partial_aa(fctx, dest, s, lo, hi, n, minLo, maxLo);
+            FCTX_STAT(fctx, pixels_solid, minHi - maxLo);
+            for (int16_t col = maxLo; col < minHi; ++col) {
+                dest[col] = (dest[col] & 0xc0) | solid;
+            }
+            fctx_fill_rect_partial_aa(fctx, dest, s, lo, hi, n, minHi, maxHi);
+        } else if (n) {
+            fctx_fill_rect_partial_aa(fctx, dest, s, lo, hi, n, minLo, maxHi);
         }
+    }
+    fctx_release_target(fctx, fb);
+    FCTX_STAT_END_PHASE(fctx, resolve_time);
+}
+
+#endif
+
+void fctx_fill_rect(FContext* fctx, FPoint min, FPoint max) {
+
+    FPoint corners[4] = {
+        { min.x, min.y }, { max.x, min.y }, { max.x, max.y }, { min.x, max.y }
+    };
+    FPoint tpoints[4];
+    fctx_begin_fill(fctx);
+    fctx_transform_points(fctx, 4, corners, tpoints, FPointZero);
+#ifdef PBL_COLOR
+    if (fctx->ops == &k_aa_ops && !fctx->fill_paint && !fctx->target && !fctx->occlusion) {
+        fctx_fill_rect_aa(fctx, &tpoints[0], &tpoints[2]);
+        return;
+    }
+#endif
+    // The horizontal edges toggle nothing, and the vertical ones take the
+    // plotters' fast path.
+    fctx_plot_edge(fctx, &tpoints[1], &tpoints[2]);
+    fctx_plot_edge(fctx, &tpoints[3], &tpoints[0]);
+    fctx_end_fill(fctx);
+}
+
+// --------------------------------------------------------------------------
+// Arcs
+// --------------------------------------------------------------------------
 
-        if (func) {
-            func(fctx, tpoints);
+static uint32_t fctx_isqrt(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
         }
+        bit >>= 2;
     }
+    return root;
+}
+
+/*
+ * The number of chords for an arc of the given radius (in path units) and
+ * angle, so that no chord strays from the arc by more than the tolerance
+ * of the context's mode once the arc is scaled onto the screen.  A chord
+ * spanning t radians strays by r(1 - cos(t/2)), or about r t^2 / 8.
+ */
+static int32_t fctx_arc_segments(FContext* fctx, fixed_t radius, int32_t angle) {
+    int64_t rx = (int64_t)abs(radius) * abs(fctx->transform_scale_to.x) / abs(fctx->transform_scale_from.x);
+    int64_t ry = (int64_t)abs(radius) * abs(fctx->transform_scale_to.y) / abs(fctx->transform_scale_from.y);
+    int64_t r = (rx > ry) ? rx : ry;
+    if (r > INT_TO_FIXED(4096)) r = INT_TO_FIXED(4096);
+    fixed_t tolerance = (fctx->mode == FContextModeAA) ? FCTX_ARC_ERROR_AA : FCTX_ARC_ERROR_BW;
+
+    // segments = angle/TRIG_MAX_ANGLE * 2pi * sqrt(r / (8 tolerance)), with
+    // the square root taken at a scale of 16 and 2pi taken as 201/32.
+    int64_t k = fctx_isqrt((uint32_t)(r * 256 / (8 * tolerance)));
+    int64_t d = (int64_t)16 * 32 * TRIG_MAX_ANGLE;
+    int32_t n = (int32_t)((angle * k * 201 + d - 1) / d);
+    int32_t n_min = (angle * 8 + TRIG_MAX_ANGLE - 1) / TRIG_MAX_ANGLE;
+    if (n < n_min) n = n_min;
+    if (n > FCTX_ARC_MAX_SEGMENTS) n = FCTX_ARC_MAX_SEGMENTS;
+    return n;
+}
+
+/*
+ * Plot the chords of an arc from angle a0 to a1, continuing the outline from
+ * prev, which is updated to the last point.  The first point is plotted only
+ * if join is set.
+ */
+static void fctx_plot_arc(FContext* fctx, FPoint center, fixed_t radius,
+            int32_t a0, int32_t a1, int32_t segments, FPoint* prev, bool join) {
+    for (int32_t i = join ? 0 : 1; i <= segments; ++i) {
+        int32_t angle = a0 + (a1 - a0) * i / segments;
+        FPoint p = {
+            center.x + (fixed_wide_t)sin_lookup(angle) * radius / TRIG_MAX_RATIO,
+            center.y - (fixed_wide_t)cos_lookup(angle) * radius / TRIG_MAX_RATIO
+        };
+        FPoint t;
+        fctx_transform_points(fctx, 1, &p, &t, FPointZero);
+        fctx_plot_edge(fctx, prev, &t);
+        *prev = t;
+    }
+}
+
+void fctx_draw_ring_arc(FContext* fctx, FPoint center, fixed_t outer_radius, fixed_t inner_radius,
+            int32_t start_angle, int32_t end_angle) {
+
+    if (end_angle < start_angle) {
+        int32_t a = start_angle;
+        start_angle = end_angle;
+        end_angle = a;
+    }
+    if (end_angle - start_angle > TRIG_MAX_ANGLE) {
+        end_angle = start_angle + TRIG_MAX_ANGLE;
+    }
+    int32_t angle = end_angle - start_angle;
+    if (angle == 0 || outer_radius == inner_radius) {
+        return;
+    }
+
+    // The outline runs clockwise along the outer arc, then back along the
+    // inner arc, or through the center of a pie.  The radial edges end
+    // exactly at the start and end angles.
+    FPoint first = {
+        center.x + (fixed_wide_t)sin_lookup(start_angle) * outer_radius / TRIG_MAX_RATIO,
+        center.y - (fixed_wide_t)cos_lookup(start_angle) * outer_radius / TRIG_MAX_RATIO
+    };
+    FPoint start, prev;
+    fctx_transform_points(fctx, 1, &first, &start, FPointZero);
+    prev = start;
+    int32_t n = fctx_arc_segments(fctx, outer_radius, angle);
+    fctx_plot_arc(fctx, center, outer_radius, start_angle, end_angle, n, &prev, false);
+    if (inner_radius > 0) {
+        n = fctx_arc_segments(fctx, inner_radius, angle);
+        fctx_plot_arc(fctx, center, inner_radius, end_angle, start_angle, n, &prev, true);
+    } else {
+        FPoint t;
+        fctx_transform_points(fctx, 1, &center, &t, FPointZero);
+        fctx_plot_edge(fctx, &prev, &t);
+        prev = t;
+    }
+    fctx_plot_edge(fctx, &prev, &start);
+}
+
+void fctx_draw_pie(FContext* fctx, FPoint center, fixed_t radius, int32_t start_angle, int32_t end_angle) {
+    fctx_draw_ring_arc(fctx, center, radius, 0, start_angle, end_angle);
 }
 
 // --------------------------------------------------------------------------
@@ -714,13 +2067,13 @@ void fctx_draw_commands(FContext* fctx, FPoint advance, void* path_data, uint16_
 // --------------------------------------------------------------------------
 
 void fctx_set_text_em_height(FContext* fctx, FFont* font, int16_t pixels) {
-    fctx->transform_scale_from.x = FIXED_TO_INT(font->units_per_em);
+    fctx->transform_scale_from.x = FIXED_TO_INT(FIXED16_TO_FIXED(font->units_per_em));
     fctx->transform_scale_from.y = -fctx->transform_scale_from.x;
     fctx->transform_scale_to.x = pixels;
     fctx->transform_scale_to.y = pixels;
 }
 
-void fctx_draw_string(FContext* fctx, const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor) {
+FPoint fctx_string_origin(const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor) {
 
     FPoint advance = FPointZero;
     uint16_t code_point;
@@ -734,7 +2087,7 @@ void fctx_draw_string(FContext* fctx, const char* text, FFont* font, GTextAlignm
             if (0 == utf8_decode_byte(*p, &decode_state, &code_point)) {
                 FGlyph* glyph = ffont_glyph_info(font, code_point);
                 if (glyph) {
-                    width += glyph->horiz_adv_x;
+                    width += FIXED16_TO_FIXED(glyph->horiz_adv_x);
                 }
             }
         }
@@ -746,24 +2099,386 @@ void fctx_draw_string(FContext* fctx, const char* text, FFont* font, GTextAlignm
     }
 
     if (anchor == FTextAnchorBottom) {
-        advance.y = -font->descent;
+        advance.y = -FIXED16_TO_FIXED(font->descent);
     } else if (anchor == FTextAnchorMiddle) {
-        advance.y = -font->ascent / 2;
+        advance.y = -FIXED16_TO_FIXED(font->ascent) / 2;
     } else if (anchor == FTextAnchorTop) {
-        advance.y = -font->ascent;
+        advance.y = -FIXED16_TO_FIXED(font->ascent);
     } else /* anchor == FTextAnchorBaseline) */ {
         advance.y = 0;
     }
+    return advance;
+}
+
+void fctx_draw_string(FContext* fctx, const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor) {
+
+    FPoint advance = fctx_string_origin(text, font, alignment, anchor);
+    uint16_t code_point;
+    uint16_t decode_state;
+    const char* p;
 
     decode_state = 0;
     for (p = text; *p; ++p) {
         if (0 == utf8_decode_byte(*p, &decode_state, &code_point)) {
             FGlyph* glyph = ffont_glyph_info(font, code_point);
             if (glyph) {
-                void* path_data = ffont_glyph_outline(font, glyph);
-                fctx_draw_commands(fctx, advance, path_data, glyph->path_data_length);
-                advance.x += glyph->horiz_adv_x;
+                if (!(glyph->path_data_length & FFONT_GLYPH_PENDING)) {
+                    void* path_data = ffont_glyph_outline(font, glyph);
+                    fctx_draw_commands(fctx, advance, path_data, glyph->path_data_length);
+                }
+                advance.x += FIXED16_TO_FIXED(glyph->horiz_adv_x);
             }
         }
     }
 }
+
+// --------------------------------------------------------------------------
+// Flattened paths
+// --------------------------------------------------------------------------
+
+void fflat_path_init(FFlatPath* flat) {
+    flat->count = 0;
+    flat->capacity = 0;
+    flat->points = NULL;
+    fflat_path_clear(flat);
+}
+
+void fflat_path_clear(FFlatPath* flat) {
+    flat->count = 0;
+    flat->min = FPoint(INT32_MAX, INT32_MAX);
+    flat->max = FPoint(INT32_MIN, INT32_MIN);
+}
+
+void fflat_path_destroy(FFlatPath* flat) {
+    free(flat->points);
+    fflat_path_init(flat);
+}
+
+static bool fflat_path_reserve(FFlatPath* flat, uint32_t capacity) {
+    if (capacity <= flat->capacity) {
+        return true;
+    }
+    uint32_t grow = flat->capacity ? flat->capacity * 2 : 16;
+    if (grow < capacity) grow = capacity;
+    if (grow > UINT16_MAX) grow = UINT16_MAX;
+    if (grow < capacity) {
+        return false;
+    }
+    FPoint* points = realloc(flat->points, grow * sizeof(FPoint));
+    if (!points) {
+        return false;
+    }
+    flat->points = points;
+    flat->capacity = grow;
+    return true;
+}
+
+static inline void fflat_path_grow_bounds(FFlatPath* flat, FPoint* p) {
+    if (p->x < flat->min.x) flat->min.x = p->x;
+    if (p->y < flat->min.y) flat->min.y = p->y;
+    if (p->x > flat->max.x) flat->max.x = p->x;
+    if (p->y > flat->max.y) flat->max.y = p->y;
+}
+
+/*
+ * The recording context stands in for a real FContext while a path is
+ * flattened.  Its plot function appends edges instead of rasterizing them.
+ */
+typedef struct FFlattenContext {
+    FContext fctx;
+    FFlatPath* flat;
+    bool failed;
+} FFlattenContext;
+
+/*
+ * Append the edge a-b, continuing the last polyline if it ends at a.
+ * @return false if the flattened path could not be grown.
+ */
+static bool fflat_path_append_edge(FFlatPath* flat, FPoint* a, FPoint* b) {
+    if (a->x == b->x && a->y == b->y) {
+        return true;
+    }
+    FPoint* last = flat->count ? flat->points + flat->count - 1 : NULL;
+    if (last && last->x == a->x && last->y == a->y) {
+        if (!fflat_path_reserve(flat, flat->count + 1)) {
+            return false;
+        }
+    } else {
+        if (!fflat_path_reserve(flat, flat->count + 3)) {
+            return false;
+        }
+        if (last) {
+            flat->points[flat->count++] = FPoint(FFLAT_PATH_BREAK, 0);
+        }
+        flat->points[flat->count++] = *a;
+        fflat_path_grow_bounds(flat, a);
+    }
+    flat->points[flat->count++] = *b;
+    fflat_path_grow_bounds(flat, b);
+    return true;
+}
+
+static void fctx_plot_edge_record(FContext* fctx, FPoint* a, FPoint* b) {
+    FFlattenContext* rec = (FFlattenContext*)fctx;
+    if (!rec->failed && !fflat_path_append_edge(rec->flat, a, b)) {
+        rec->failed = true;
+    }
+}
+
+static void fctx_end_fill_record(FContext* fctx) {
+}
+
+static const FContextOps k_record_ops = {
+    .plot_edge = &fctx_plot_edge_record,
+    .end_fill = &fctx_end_fill_record
+};
+
+static void fctx_begin_flatten(FContext* fctx, FFlattenContext* rec, FFlatPath* flat) {
+    rec->fctx = *fctx;
+    rec->fctx.ops = &k_record_ops;
+    rec->fctx.transform_offset = FPointZero;
+    rec->fctx.subpixel_adjust = 0;
+    rec->flat = flat;
+    rec->failed = false;
+}
+
+bool fctx_flatten_commands(FContext* fctx, FFlatPath* flat, FPoint advance, void* path_data, uint16_t length) {
+    FFlattenContext rec;
+    fctx_begin_flatten(fctx, &rec, flat);
+    fctx_draw_commands(&rec.fctx, advance, path_data, length);
+    return !rec.failed;
+}
+
+bool fctx_flatten_string(FContext* fctx, FFlatPath* flat, const char* text, FFont* font, GTextAlignment alignment, FTextAnchor anchor) {
+    FFlattenContext rec;
+    fctx_begin_flatten(fctx, &rec, flat);
+    fctx_draw_string(&rec.fctx, text, font, alignment, anchor);
+    return !rec.failed;
+}
+
+static inline FPoint fctx_transform_flat_point(const FPoint* p, const FTransform* t, int32_t c, int32_t s, fixed_t adjust) {
+    FPoint q;
+    if (t->rotation) {
+        q.x = ((fixed_wide_t)p->x * c - (fixed_wide_t)p->y * s) / TRIG_MAX_RATIO;
+        q.y = ((fixed_wide_t)p->x * s + (fixed_wide_t)p->y * c) / TRIG_MAX_RATIO;
+    } else {
+        q = *p;
+    }
+    q.x += t->offset.x + adjust;
+    q.y += t->offset.y + adjust;
+    return q;
+}
+
+bool fctx_transform_flat_path(FContext* fctx, const FFlatPath* src, const FTransform* transform, FFlatPath* dst) {
+    fflat_path_clear(dst);
+    if (!fflat_path_reserve(dst, src->count)) {
+        return false;
+    }
+    int32_t c = cos_lookup(transform->rotation);
+    int32_t s = sin_lookup(transform->rotation);
+    const FPoint* p = src->points;
+    const FPoint* end = p + src->count;
+    FPoint* q = dst->points;
+    for (; p < end; ++p, ++q) {
+        if (p->x == FFLAT_PATH_BREAK) {
+            *q = *p;
+        } else {
+            *q = fctx_transform_flat_point(p, transform, c, s, fctx->subpixel_adjust);
+            fflat_path_grow_bounds(dst, q);
+        }
+    }
+    dst->count = src->count;
+    return true;
+}
+
+void fctx_plot_flat_path(FContext* fctx, const FFlatPath* flat) {
+
+    if (flat->count == 0) {
+        return;
+    }
+    if (flat->min.x < fctx->extent_min.x) fctx->extent_min.x = flat->min.x;
+    if (flat->min.y < fctx->extent_min.y) fctx->extent_min.y = flat->min.y;
+    if (flat->max.x > fctx->extent_max.x) fctx->extent_max.x = flat->max.x;
+    if (flat->max.y > fctx->extent_max.y) fctx->extent_max.y = flat->max.y;
+
+    FPoint* p = flat->points;
+    FPoint* end = p + flat->count;
+    FPoint* prev = NULL;
+    for (; p < end; ++p) {
+        if (p->x == FFLAT_PATH_BREAK) {
+            prev = NULL;
+            continue;
+        }
+        if (prev) {
+            fctx_plot_edge(fctx, prev, p);
+        }
+        prev = p;
+    }
+}
+
+/*
+ * Rotate, offset and plot count instances of a flattened path, with the edge
+ * plotter inlined.  Instance i takes its transform from transforms[i], or, if
+ * symmetric is set, from transforms[0] turned by i / count of a revolution.
+ * Instances that lie wholly above, below or right of the flag buffer would
+ * plot nothing, so they are skipped when cull is set.
+ */
+FCTX_ALWAYS_INLINE void fctx_draw_flat_instances(FContext* fctx, const FFlatPath* flat,
+            const FTransform* transforms, uint16_t count, bool symmetric, bool cull, fctx_plot_edge_func plot) {
+
+    // Every point of the path lies within this distance of its origin, at
+    // any rotation.
+    fixed_t reach = 0;
+    if (cull && flat->min.x <= flat->max.x) {
+        fixed_t rx = (flat->max.x > -flat->min.x) ? flat->max.x : -flat->min.x;
+        fixed_t ry = (flat->max.y > -flat->min.y) ? flat->max.y : -flat->min.y;
+        reach = rx + ry + FIX1;
+    }
+    fixed_t right = INT_TO_FIXED(fctx->flag_bounds.size.w);
+    fixed_t bottom = INT_TO_FIXED(fctx->flag_bounds.size.h);
+
+    for (uint16_t k = 0; k < count; ++k) {
+        FTransform transform = symmetric ? transforms[0] : transforms[k];
+        if (symmetric) {
+            transform.rotation += k * TRIG_MAX_ANGLE / count;
+        }
+        if (cull && (transform.offset.y + reach < 0 || transform.offset.y - reach > bottom ||
+                     transform.offset.x - reach > right)) {
+            continue;
+        }
+        int32_t c = cos_lookup(transform.rotation);
+        int32_t s = sin_lookup(transform.rotation);
+        const FPoint* p = flat->points;
+        const FPoint* end = p + flat->count;
+        FPoint a, b;
+        bool open = false;
+        for (; p < end; ++p) {
+            if (p->x == FFLAT_PATH_BREAK) {
+                open = false;
+                continue;
+            }
+            b = fctx_transform_flat_point(p, &transform, c, s, fctx->subpixel_adjust);
+            if (b.x < fctx->extent_min.x) fctx->extent_min.x = b.x;
+            if (b.y < fctx->extent_min.y) fctx->extent_min.y = b.y;
+            if (b.x > fctx->extent_max.x) fctx->extent_max.x = b.x;
+            if (b.y > fctx->extent_max.y) fctx->extent_max.y = b.y;
+            if (open) {
+                plot(fctx, &a, &b);
+            }
+            a = b;
+            open = true;
+        }
+    }
+}
+
+static void fctx_draw_flat_path_dispatch(FContext* fctx, const FFlatPath* flat,
+            const FTransform* transforms, uint16_t count, bool symmetric) {
+#ifdef PBL_COLOR
+    if (fctx->ops == &k_aa_ops) {
+        fctx_draw_flat_instances(fctx, flat, transforms, count, symmetric, true, &fctx_plot_edge_aa);
+        return;
+    }
+#endif
+    if (fctx->ops == &k_bw_ops) {
+        fctx_draw_flat_instances(fctx, flat, transforms, count, symmetric, true, &fctx_plot_edge_bw);
+    } else {
+        // A banded context records every edge, and its flag buffer is
+        // smaller than the target, so nothing is culled.
+        fctx_draw_flat_instances(fctx, flat, transforms, count, symmetric, false, fctx->ops->plot_edge);
+    }
+}
+
+void fctx_draw_flat_path(FContext* fctx, const FFlatPath* flat, const FTransform* transform) {
+    fctx_draw_flat_path_dispatch(fctx, flat, transform, 1, false);
+}
+
+void fctx_draw_flat_path_instances(FContext* fctx, const FFlatPath* flat, const FTransform* transforms, uint16_t count) {
+    fctx_draw_flat_path_dispatch(fctx, flat, transforms, count, false);
+}
+
+void fctx_draw_flat_path_symmetric(FContext* fctx, const FFlatPath* flat, const FTransform* transform, uint16_t count) {
+    fctx_draw_flat_path_dispatch(fctx, flat, transform, count, true);
+}
+
+bool fctx_draw_commands_instances(FContext* fctx, FPoint advance, void* path_data, uint16_t length,
+            const FTransform* transforms, uint16_t count) {
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    bool ok = fctx_flatten_commands(fctx, &flat, advance, path_data, length);
+    if (ok) {
+        fctx_draw_flat_path_instances(fctx, &flat, transforms, count);
+    }
+    fflat_path_destroy(&flat);
+    return ok;
+}
+
+// --------------------------------------------------------------------------
+// Static paths
+// --------------------------------------------------------------------------
+
+/*
+ * Scale, rotate, offset and plot a static path, with the edge plotter
+ * inlined.  A path that lies wholly above, below or right of the flag buffer
+ * would plot nothing, so it is skipped when cull is set.
+ */
+FCTX_ALWAYS_INLINE void fctx_draw_static_edges(FContext* fctx, const FStaticPath* path,
+            const FTransform* transform, bool cull, fctx_plot_edge_func plot) {
+
+    FPoint from = fctx->transform_scale_from;
+    FPoint to = fctx->transform_scale_to;
+    if (cull && path->count) {
+        // Every point of the path lies within this distance of its origin,
+        // at any rotation.
+        fixed_t rx = (path->max.x > -path->min.x) ? path->max.x : -path->min.x;
+        fixed_t ry = (path->max.y > -path->min.y) ? path->max.y : -path->min.y;
+        rx = (fixed_wide_t)FIXED16_TO_FIXED(rx) * abs(to.x) / abs(from.x);
+        ry = (fixed_wide_t)FIXED16_TO_FIXED(ry) * abs(to.y) / abs(from.y);
+        fixed_t reach = rx + ry + FIX1;
+        if (transform->offset.y + reach < 0 ||
+            transform->offset.y - reach > INT_TO_FIXED(fctx->flag_bounds.size.h) ||
+            transform->offset.x - reach > INT_TO_FIXED(fctx->flag_bounds.size.w)) {
+            return;
+        }
+    }
+
+    int32_t c = cos_lookup(transform->rotation);
+    int32_t s = sin_lookup(transform->rotation);
+    const FPoint16* p = path->points;
+    const FPoint16* end = p + path->count;
+    FPoint a, b;
+    bool open = false;
+    for (; p < end; ++p) {
+        if (p->x == FSTATIC_PATH_BREAK) {
+            open = false;
+            continue;
+        }
+        FPoint q = {
+            (fixed_wide_t)FIXED16_TO_FIXED(p->x) * to.x / from.x,
+            (fixed_wide_t)FIXED16_TO_FIXED(p->y) * to.y / from.y
+        };
+        b = fctx_transform_flat_point(&q, transform, c, s, fctx->subpixel_adjust);
+        if (b.x < fctx->extent_min.x) fctx->extent_min.x = b.x;
+        if (b.y < fctx->extent_min.y) fctx->extent_min.y = b.y;
+        if (b.x > fctx->extent_max.x) fctx->extent_max.x = b.x;
+        if (b.y > fctx->extent_max.y) fctx->extent_max.y = b.y;
+        if (open) {
+            plot(fctx, &a, &b);
+        }
+        a = b;
+        open = true;
+    }
+}
+
+void fctx_draw_static_path(FContext* fctx, const FStaticPath* path, const FTransform* transform) {
+#ifdef PBL_COLOR
+    if (fctx->ops == &k_aa_ops) {
+        fctx_draw_static_edges(fctx, path, transform, true, &fctx_plot_edge_aa);
+        return;
+    }
+#endif
+    if (fctx->ops == &k_bw_ops) {
+        fctx_draw_static_edges(fctx, path, transform, true, &fctx_plot_edge_bw);
+    } else {
+        fctx_draw_static_edges(fctx, path, transform, false, fctx->ops->plot_edge);
+    }
+}
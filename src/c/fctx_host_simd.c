@@ -0,0 +1,361 @@
+
+#include "fctx.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --------------------------------------------------------------------------
+// Host resolve kernels.
+//
+// Vector versions of the solid color AA resolve, for rendering on a
+// development machine or server.  Each kernel must give exactly the same
+// pixels as fctx_resolve_span_scalar, which is the loop in fctx_end_fill_aa.
+// The SSE2 kernel is the x86-64 baseline; the AVX2 kernel is compiled with a
+// target attribute and used only if the CPU supports it.
+// --------------------------------------------------------------------------
+
+#if defined(FCTX_HOST) && defined(PBL_COLOR)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FCTX_HOST_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define FCTX_HOST_NEON
+#include <arm_neon.h>
+#endif
+
+uint8_t countBits(uint8_t v);
+
+void fctx_resolve_span_scalar(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    uint8_t mask = 0;
+    GColor8 d;
+    for (int32_t k = 0; k < count; ++k) {
+        mask ^= flags[k];
+        flags[k] = 0;
+        uint8_t a = countBits(mask);
+        if (a) {
+            d.argb = dest[k];
+            d.r = (s.r*a + d.r*(8 - a) + 4) / 8;
+            d.g = (s.g*a + d.g*(8 - a) + 4) / 8;
+            d.b = (s.b*a + d.b*(8 - a) + 4) / 8;
+            dest[k] = d.argb;
+        }
+    }
+}
+
+/*
+ * All of the vector kernels blend every pixel with the same formula: with a
+ * coverage of 0 it gives back the destination, so no select is needed.
+ *   c = (s * a + d * (8 - a) + 4) / 8 for each 2-bit channel.
+ */
+
+#ifdef FCTX_HOST_X86
+
+/* Blend 8 pixels, zero-extended to 16 bits, with their coverage. */
+static inline __m128i fctx_blend8_sse2(__m128i d, __m128i a, __m128i sb, __m128i sg, __m128i sr) {
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i four = _mm_set1_epi16(4);
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(8), a);
+    __m128i b = _mm_and_si128(d, three);
+    __m128i g = _mm_and_si128(_mm_srli_epi16(d, 2), three);
+    __m128i r = _mm_and_si128(_mm_srli_epi16(d, 4), three);
+    b = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(b, inv), _mm_mullo_epi16(sb, a)), four), 3);
+    g = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(g, inv), _mm_mullo_epi16(sg, a)), four), 3);
+    r = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, inv), _mm_mullo_epi16(sr, a)), four), 3);
+    __m128i out = _mm_and_si128(d, _mm_set1_epi16(0xc0));
+    out = _mm_or_si128(out, _mm_slli_epi16(r, 4));
+    out = _mm_or_si128(out, _mm_slli_epi16(g, 2));
+    return _mm_or_si128(out, b);
+}
+
+/* Count the bits in each byte. */
+static inline __m128i fctx_popcount8_sse2(__m128i v) {
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x55)));
+    v = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x33)), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi8(0x33)));
+    return _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), _mm_set1_epi8(0x0f));
+}
+
+/* Resolve 16 pixels, starting with the running XOR of the flags to their left. */
+static inline uint8_t fctx_resolve16_sse2(uint8_t* dest, uint8_t* flags, uint8_t carry, GColor8 s) {
+    __m128i x = _mm_loadu_si128((__m128i*)flags);
+    _mm_storeu_si128((__m128i*)flags, _mm_setzero_si128());
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 1));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 2));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+    x = _mm_xor_si128(x, _mm_set1_epi8(carry));
+    carry = _mm_extract_epi16(x, 7) >> 8;
+
+    __m128i a = fctx_popcount8_sse2(x);
+    __m128i d = _mm_loadu_si128((__m128i*)dest);
+    __m128i zero = _mm_setzero_si128();
+    __m128i sb = _mm_set1_epi16(s.b);
+    __m128i sg = _mm_set1_epi16(s.g);
+    __m128i sr = _mm_set1_epi16(s.r);
+    __m128i lo = fctx_blend8_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(a, zero), sb, sg, sr);
+    __m128i hi = fctx_blend8_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(a, zero), sb, sg, sr);
+    _mm_storeu_si128((__m128i*)dest, _mm_packus_epi16(lo, hi));
+    return carry;
+}
+
+/* Resolve the last few pixels of a span through a 16 pixel buffer. */
+static inline void fctx_resolve_tail_sse2(uint8_t* dest, uint8_t* flags, int32_t count, uint8_t carry, GColor8 s) {
+    uint8_t d[16] = { 0 };
+    uint8_t f[16] = { 0 };
+    memcpy(d, dest, count);
+    memcpy(f, flags, count);
+    fctx_resolve16_sse2(d, f, carry, s);
+    memcpy(dest, d, count);
+    memset(flags, 0, count);
+}
+
+static void fctx_resolve_span_sse2(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    uint8_t carry = 0;
+    int32_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        carry = fctx_resolve16_sse2(dest + k, flags + k, carry, s);
+    }
+    if (k < count) {
+        fctx_resolve_tail_sse2(dest + k, flags + k, count - k, carry, s);
+    }
+}
+
+#define FCTX_AVX2 __attribute__((target("avx2")))
+
+FCTX_AVX2 static inline __m256i fctx_blend16_avx2(__m256i d, __m256i a, __m256i sb, __m256i sg, __m256i sr) {
+    const __m256i three = _mm256_set1_epi16(3);
+    const __m256i four = _mm256_set1_epi16(4);
+    __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(8), a);
+    __m256i b = _mm256_and_si256(d, three);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi16(d, 2), three);
+    __m256i r = _mm256_and_si256(_mm256_srli_epi16(d, 4), three);
+    b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(b, inv), _mm256_mullo_epi16(sb, a)), four), 3);
+    g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, inv), _mm256_mullo_epi16(sg, a)), four), 3);
+    r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, inv), _mm256_mullo_epi16(sr, a)), four), 3);
+    __m256i out = _mm256_and_si256(d, _mm256_set1_epi16(0xc0));
+    out = _mm256_or_si256(out, _mm256_slli_epi16(r, 4));
+    out = _mm256_or_si256(out, _mm256_slli_epi16(g, 2));
+    return _mm256_or_si256(out, b);
+}
+
+/* Resolve 32 pixels.  The prefix XOR runs in each 128-bit lane, and then the
+   last byte of the low lane is carried into the high lane. */
+FCTX_AVX2 static inline uint8_t fctx_resolve32_avx2(uint8_t* dest, uint8_t* flags, uint8_t carry, GColor8 s) {
+    __m256i x = _mm256_loadu_si256((__m256i*)flags);
+    _mm256_storeu_si256((__m256i*)flags, _mm256_setzero_si256());
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 1));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 2));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 4));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 8));
+    uint8_t mid = (_mm256_extract_epi16(x, 7) >> 8) ^ carry;
+    x = _mm256_xor_si256(x, _mm256_set_m128i(_mm_set1_epi8(mid), _mm_set1_epi8(carry)));
+    carry = _mm256_extract_epi16(x, 15) >> 8;
+
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i a = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x, nibble)),
+                                _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+
+    __m256i d = _mm256_loadu_si256((__m256i*)dest);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sb = _mm256_set1_epi16(s.b);
+    __m256i sg = _mm256_set1_epi16(s.g);
+    __m256i sr = _mm256_set1_epi16(s.r);
+    // unpack and pack both work within lanes, so the pixel order is kept.
+    __m256i lo = fctx_blend16_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(a, zero), sb, sg, sr);
+    __m256i hi = fctx_blend16_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(a, zero), sb, sg, sr);
+    _mm256_storeu_si256((__m256i*)dest, _mm256_packus_epi16(lo, hi));
+    return carry;
+}
+
+FCTX_AVX2 static void fctx_resolve_span_avx2(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    uint8_t carry = 0;
+    int32_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        carry = fctx_resolve32_avx2(dest + k, flags + k, carry, s);
+    }
+    for (; k + 16 <= count; k += 16) {
+        carry = fctx_resolve16_sse2(dest + k, flags + k, carry, s);
+    }
+    if (k < count) {
+        fctx_resolve_tail_sse2(dest + k, flags + k, count - k, carry, s);
+    }
+}
+
+#endif // FCTX_HOST_X86
+
+#ifdef FCTX_HOST_NEON
+
+static inline uint8x8_t fctx_blend8_neon(uint8x8_t d, uint8x8_t a, GColor8 s) {
+    const uint8x8_t three = vdup_n_u8(3);
+    uint8x8_t inv = vsub_u8(vdup_n_u8(8), a);
+    // Each channel fits in 8 bits: 3 * 8 + 4 at most.
+    uint8x8_t b = vand_u8(d, three);
+    uint8x8_t g = vand_u8(vshr_n_u8(d, 2), three);
+    uint8x8_t r = vand_u8(vshr_n_u8(d, 4), three);
+    b = vshr_n_u8(vadd_u8(vmla_u8(vmul_u8(b, inv), a, vdup_n_u8(s.b)), vdup_n_u8(4)), 3);
+    g = vshr_n_u8(vadd_u8(vmla_u8(vmul_u8(g, inv), a, vdup_n_u8(s.g)), vdup_n_u8(4)), 3);
+    r = vshr_n_u8(vadd_u8(vmla_u8(vmul_u8(r, inv), a, vdup_n_u8(s.r)), vdup_n_u8(4)), 3);
+    uint8x8_t out = vand_u8(d, vdup_n_u8(0xc0));
+    out = vorr_u8(out, vshl_n_u8(r, 4));
+    out = vorr_u8(out, vshl_n_u8(g, 2));
+    return vorr_u8(out, b);
+}
+
+static uint8_t fctx_resolve16_neon(uint8_t* dest, uint8_t* flags, uint8_t carry, GColor8 s) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    uint8x16_t x = vld1q_u8(flags);
+    vst1q_u8(flags, zero);
+    x = veorq_u8(x, vextq_u8(zero, x, 15));
+    x = veorq_u8(x, vextq_u8(zero, x, 14));
+    x = veorq_u8(x, vextq_u8(zero, x, 12));
+    x = veorq_u8(x, vextq_u8(zero, x, 8));
+    x = veorq_u8(x, vdupq_n_u8(carry));
+    carry = vgetq_lane_u8(x, 15);
+
+    uint8x16_t a = vcntq_u8(x);
+    uint8x16_t d = vld1q_u8(dest);
+    uint8x8_t lo = fctx_blend8_neon(vget_low_u8(d), vget_low_u8(a), s);
+    uint8x8_t hi = fctx_blend8_neon(vget_high_u8(d), vget_high_u8(a), s);
+    vst1q_u8(dest, vcombine_u8(lo, hi));
+    return carry;
+}
+
+static void fctx_resolve_span_neon(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    uint8_t carry = 0;
+    int32_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        carry = fctx_resolve16_neon(dest + k, flags + k, carry, s);
+    }
+    if (k < count) {
+        uint8_t d[16] = { 0 };
+        uint8_t f[16] = { 0 };
+        memcpy(d, dest + k, count - k);
+        memcpy(f, flags + k, count - k);
+        fctx_resolve16_neon(d, f, carry, s);
+        memcpy(dest + k, d, count - k);
+        memset(flags + k, 0, count - k);
+    }
+}
+
+#endif // FCTX_HOST_NEON
+
+// --------------------------------------------------------------------------
+// Dispatch.
+// --------------------------------------------------------------------------
+
+static const struct {
+    const char* name;
+    fctx_resolve_span_func resolve;
+} k_kernels[] = {
+    { "scalar", &fctx_resolve_span_scalar },
+#ifdef FCTX_HOST_X86
+    { "sse2", &fctx_resolve_span_sse2 },
+    { "avx2", &fctx_resolve_span_avx2 },
+#endif
+#ifdef FCTX_HOST_NEON
+    { "neon", &fctx_resolve_span_neon },
+#endif
+};
+
+#define FCTX_KERNEL_COUNT (sizeof(k_kernels) / sizeof(k_kernels[0]))
+
+static bool fctx_kernel_supported(uint8_t k) {
+#ifdef FCTX_HOST_X86
+    if (k_kernels[k].resolve == &fctx_resolve_span_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return true;
+}
+
+static void fctx_resolve_span_select(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s);
+
+static uint8_t s_kernel;
+static fctx_resolve_span_func s_resolve = &fctx_resolve_span_select;
+
+/* The first call picks the last supported kernel, which is the widest,
+   unless the FCTX_KERNEL environment variable names another. */
+static void fctx_resolve_span_select(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    const char* name = getenv("FCTX_KERNEL");
+    if (!name || !fctx_host_select_kernel(name)) {
+        for (uint8_t k = 0; k < FCTX_KERNEL_COUNT; ++k) {
+            if (fctx_kernel_supported(k)) {
+                s_kernel = k;
+            }
+        }
+        s_resolve = k_kernels[s_kernel].resolve;
+    }
+    s_resolve(dest, flags, count, s);
+}
+
+void fctx_resolve_span(uint8_t* dest, uint8_t* flags, int32_t count, GColor8 s) {
+    s_resolve(dest, flags, count, s);
+}
+
+bool fctx_host_select_kernel(const char* name) {
+    for (uint8_t k = 0; k < FCTX_KERNEL_COUNT; ++k) {
+        if (!strcmp(name, k_kernels[k].name) && fctx_kernel_supported(k)) {
+            s_kernel = k;
+            s_resolve = k_kernels[k].resolve;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* fctx_host_kernel_name(void) {
+    if (s_resolve == &fctx_resolve_span_select) {
+        // Let the first call pick the kernel.
+        uint8_t dest = 0;
+        uint8_t flags = 0;
+        fctx_resolve_span(&dest, &flags, 1, GColorWhite);
+    }
+    return k_kernels[s_kernel].name;
+}
+
+static uint32_t fctx_self_test_random(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+int fctx_host_self_test(uint32_t iterations) {
+    enum { MAX_SPAN = 300 };
+    uint8_t dest[MAX_SPAN], flags[MAX_SPAN];
+    uint8_t ref_dest[MAX_SPAN], ref_flags[MAX_SPAN];
+    uint32_t state = 1;
+    int failures = 0;
+
+    for (uint8_t k = 1; k < FCTX_KERNEL_COUNT; ++k) {
+        if (!fctx_kernel_supported(k)) {
+            APP_LOG(APP_LOG_LEVEL_INFO, "kernel %s: not supported", k_kernels[k].name);
+            continue;
+        }
+        int mismatches = 0;
+        for (uint32_t n = 0; n < iterations; ++n) {
+            int32_t count = fctx_self_test_random(&state) % MAX_SPAN;
+            GColor8 s;
+            s.argb = fctx_self_test_random(&state) | 0xc0;
+            // Sparse flags, like a real edge list, with some dense runs.
+            bool dense = fctx_self_test_random(&state) % 4 == 0;
+            for (int32_t j = 0; j < count; ++j) {
+                uint32_t r = fctx_self_test_random(&state);
+                dest[j] = r;
+                flags[j] = (dense || (r >> 8) % 8 == 0) ? (r >> 16) : 0;
+            }
+            memcpy(ref_dest, dest, count);
+            memcpy(ref_flags, flags, count);
+            fctx_resolve_span_scalar(ref_dest, ref_flags, count, s);
+            k_kernels[k].resolve(dest, flags, count, s);
+            if (memcmp(dest, ref_dest, count) || memcmp(flags, ref_flags, count)) {
+                ++mismatches;
+            }
+        }
+        APP_LOG(APP_LOG_LEVEL_INFO, "kernel %s: %d of %u spans differ from scalar",
+                k_kernels[k].name, mismatches, (unsigned)iterations);
+        failures += mismatches;
+    }
+    return failures;
+}
+
+#endif // FCTX_HOST && PBL_COLOR
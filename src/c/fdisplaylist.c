@@ -0,0 +1,240 @@
+
+#include "fdisplaylist.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FDISPLAY_DIRTY_COLOR     1
+#define FDISPLAY_DIRTY_TRANSFORM 2
+#define FDISPLAY_DIRTY_CONTENT   4
+
+FDisplayList* fdisplay_list_create(uint16_t capacity) {
+    FDisplayList* list = malloc(sizeof(FDisplayList));
+    if (list) {
+        list->nodes = malloc(capacity * sizeof(FDisplayNode));
+        if (!list->nodes) {
+            free(list);
+            return NULL;
+        }
+        list->count = 0;
+        list->capacity = capacity;
+        list->subpixel_adjust = 0;
+        list->coarse_curves = false;
+        list->changed_bounds = GRectZero;
+    }
+    return list;
+}
+
+void fdisplay_list_destroy(FDisplayList* list) {
+    if (list) {
+        for (uint16_t k = 0; k < list->count; ++k) {
+            FDisplayNode* node = list->nodes + k;
+            if (node->type == FDisplayNodeTypeText) {
+                free(node->text.string);
+            }
+            fflat_path_destroy(&node->local);
+            fflat_path_destroy(&node->screen);
+        }
+        free(list->nodes);
+        free(list);
+    }
+}
+
+static FDisplayNode* fdisplay_list_add_node(FDisplayList* list, FDisplayNodeType type, GColor fill_color) {
+    if (list->count >= list->capacity) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "display list full");
+        return NULL;
+    }
+    FDisplayNode* node = list->nodes + list->count++;
+    memset(node, 0, sizeof(FDisplayNode));
+    node->type = type;
+    node->dirty = FDISPLAY_DIRTY_CONTENT;
+    node->visible = true;
+    node->fill_color = fill_color;
+    node->scale_from = FPointOne;
+    node->scale_to = FPointOne;
+    fflat_path_init(&node->local);
+    fflat_path_init(&node->screen);
+    return node;
+}
+
+FDisplayNode* fdisplay_list_add_path(FDisplayList* list, void* path_data, uint16_t length, GColor fill_color) {
+    FDisplayNode* node = fdisplay_list_add_node(list, FDisplayNodeTypePath, fill_color);
+    if (node) {
+        node->path.data = path_data;
+        node->path.length = length;
+    }
+    return node;
+}
+
+FDisplayNode* fdisplay_list_add_text(FDisplayList* list, const char* text, FFont* font, int16_t em_height,
+                                     GTextAlignment alignment, FTextAnchor anchor, GColor fill_color) {
+    FDisplayNode* node = fdisplay_list_add_node(list, FDisplayNodeTypeText, fill_color);
+    if (node) {
+        node->text.font = font;
+        node->text.em_height = em_height;
+        node->text.alignment = alignment;
+        node->text.anchor = anchor;
+        fdisplay_node_set_text(node, text);
+    }
+    return node;
+}
+
+void fdisplay_node_set_fill_color(FDisplayNode* node, GColor c) {
+    if (!gcolor_equal(node->fill_color, c)) {
+        node->fill_color = c;
+        node->dirty |= FDISPLAY_DIRTY_COLOR;
+    }
+}
+
+void fdisplay_node_set_visible(FDisplayNode* node, bool visible) {
+    if (node->visible != visible) {
+        node->visible = visible;
+        node->dirty |= FDISPLAY_DIRTY_COLOR;
+    }
+}
+
+void fdisplay_node_set_offset(FDisplayNode* node, FPoint offset) {
+    if (node->transform.offset.x != offset.x || node->transform.offset.y != offset.y) {
+        node->transform.offset = offset;
+        node->dirty |= FDISPLAY_DIRTY_TRANSFORM;
+    }
+}
+
+void fdisplay_node_set_rotation(FDisplayNode* node, int32_t rotation) {
+    if (node->transform.rotation != rotation) {
+        node->transform.rotation = rotation;
+        node->dirty |= FDISPLAY_DIRTY_TRANSFORM;
+    }
+}
+
+void fdisplay_node_set_pivot(FDisplayNode* node, FPoint pivot) {
+    if (node->pivot.x != pivot.x || node->pivot.y != pivot.y) {
+        node->pivot = pivot;
+        node->dirty |= FDISPLAY_DIRTY_CONTENT;
+    }
+}
+
+void fdisplay_node_set_scale(FDisplayNode* node, FPoint scale_from, FPoint scale_to) {
+    if (node->scale_from.x != scale_from.x || node->scale_from.y != scale_from.y ||
+        node->scale_to.x != scale_to.x || node->scale_to.y != scale_to.y) {
+        node->scale_from = scale_from;
+        node->scale_to = scale_to;
+        node->dirty |= FDISPLAY_DIRTY_CONTENT;
+    }
+}
+
+void fdisplay_node_set_path(FDisplayNode* node, void* path_data, uint16_t length) {
+    if (node->type != FDisplayNodeTypePath) {
+        return;
+    }
+    if (node->path.data != path_data || node->path.length != length) {
+        node->path.data = path_data;
+        node->path.length = length;
+        node->dirty |= FDISPLAY_DIRTY_CONTENT;
+    }
+}
+
+void fdisplay_node_set_text(FDisplayNode* node, const char* text) {
+    if (node->type != FDisplayNodeTypeText) {
+        return;
+    }
+    if (node->text.string && strcmp(node->text.string, text) == 0) {
+        return;
+    }
+    free(node->text.string);
+    node->text.string = malloc(strlen(text) + 1);
+    if (node->text.string) {
+        strcpy(node->text.string, text);
+    }
+    node->dirty |= FDISPLAY_DIRTY_CONTENT;
+}
+
+static GRect fdisplay_flat_path_rect(const FFlatPath* flat) {
+    if (flat->count == 0) {
+        return GRectZero;
+    }
+    int16_t x0 = FIXED_TO_INT(flat->min.x) - 1;
+    int16_t y0 = FIXED_TO_INT(flat->min.y) - 1;
+    int16_t x1 = FIXED_TO_INT(flat->max.x) + 2;
+    int16_t y1 = FIXED_TO_INT(flat->max.y) + 2;
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+static GRect fdisplay_rect_union(GRect a, GRect b) {
+    if (a.size.w <= 0 || a.size.h <= 0) return b;
+    if (b.size.w <= 0 || b.size.h <= 0) return a;
+    int16_t x0 = (a.origin.x < b.origin.x) ? a.origin.x : b.origin.x;
+    int16_t y0 = (a.origin.y < b.origin.y) ? a.origin.y : b.origin.y;
+    int16_t ax1 = a.origin.x + a.size.w, bx1 = b.origin.x + b.size.w;
+    int16_t ay1 = a.origin.y + a.size.h, by1 = b.origin.y + b.size.h;
+    int16_t x1 = (ax1 > bx1) ? ax1 : bx1;
+    int16_t y1 = (ay1 > by1) ? ay1 : by1;
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/* Flatten the content of a node at its scale, about its pivot.  A node whose
+ * content cannot be flattened is left empty. */
+static bool fdisplay_node_flatten(FContext* fctx, FDisplayNode* node) {
+    FContext tmp = *fctx;
+    FPoint advance = FPoint(-node->pivot.x, -node->pivot.y);
+    bool ok = true;
+    fflat_path_clear(&node->local);
+    if (node->type == FDisplayNodeTypePath) {
+        tmp.transform_scale_from = node->scale_from;
+        tmp.transform_scale_to = node->scale_to;
+        ok = fctx_flatten_commands(&tmp, &node->local, advance, node->path.data, node->path.length);
+    } else if (node->text.string) {
+        // The node's scale applies on top of the em height.
+        fctx_set_text_em_height(&tmp, node->text.font, node->text.em_height);
+        tmp.transform_scale_from.x *= node->scale_from.x;
+        tmp.transform_scale_from.y *= node->scale_from.y;
+        tmp.transform_scale_to.x *= node->scale_to.x;
+        tmp.transform_scale_to.y *= node->scale_to.y;
+        ok = fctx_flatten_string(&tmp, &node->local, node->text.string, node->text.font,
+                                 node->text.alignment, node->text.anchor);
+    }
+    if (!ok) {
+        fflat_path_clear(&node->local);
+    }
+    return ok;
+}
+
+void fctx_render_list(FContext* fctx, FDisplayList* list) {
+
+    bool readjust = list->subpixel_adjust != fctx->subpixel_adjust;
+    list->subpixel_adjust = fctx->subpixel_adjust;
+    bool reflatten = list->coarse_curves != fctx->coarse_curves;
+    list->coarse_curves = fctx->coarse_curves;
+    list->changed_bounds = GRectZero;
+
+    for (uint16_t k = 0; k < list->count; ++k) {
+        FDisplayNode* node = list->nodes + k;
+        if (readjust) {
+            node->dirty |= FDISPLAY_DIRTY_TRANSFORM;
+        }
+        if (reflatten) {
+            node->dirty |= FDISPLAY_DIRTY_CONTENT;
+        }
+        if (node->dirty) {
+            GRect before = fdisplay_flat_path_rect(&node->screen);
+            uint8_t retry = 0;
+            if ((node->dirty & FDISPLAY_DIRTY_CONTENT) && !fdisplay_node_flatten(fctx, node)) {
+                // Draw nothing for now, and try again on the next render.
+                APP_LOG(APP_LOG_LEVEL_WARNING, "display node %d: flatten failed", (int)k);
+                retry = FDISPLAY_DIRTY_CONTENT;
+            }
+            if (node->dirty & (FDISPLAY_DIRTY_CONTENT | FDISPLAY_DIRTY_TRANSFORM)) {
+                fctx_transform_flat_path(fctx, &node->local, &node->transform, &node->screen);
+            }
+            GRect after = fdisplay_flat_path_rect(&node->screen);
+            list->changed_bounds = fdisplay_rect_union(list->changed_bounds, fdisplay_rect_union(before, after));
+            node->dirty = retry;
+        }
+        if (node->visible && node->screen.count) {
+            fctx_begin_fill(fctx);
+            fctx_set_fill_color(fctx, node->fill_color);
+            fctx_plot_flat_path(fctx, &node->screen);
+            fctx_end_fill(fctx);
+        }
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Ordered dithering, shared by the 1-bit AA resolve and the paints.  Internal
+// to the library.
+// -----------------------------------------------------------------------------
+
+/* 4x4 ordered dither thresholds, in sixteenths. */
+extern const uint8_t fdither_bayer[4][4];
@@ -1,5 +1,14 @@
 
 #include "ffont.h"
+#include "fpath.h"
+#include <string.h>
+
+FFont* ffont_load_from_resource_into_buffer(uint32_t resource_id, void* buffer) {
+    ResHandle rh = resource_get_handle(resource_id);
+    size_t rs = resource_size(rh);
+    resource_load(rh, buffer, rs);
+    return (FFont*)buffer;
+}
 
 FFont* ffont_create_from_resource(uint32_t resource_id) {
     ResHandle rh = resource_get_handle(resource_id);
@@ -62,6 +71,72 @@ void* ffont_glyph_outline(FFont* font, FGlyph* glyph) {
     return path_data + glyph->path_data_offset;
 }
 
+size_t ffont_size(FFont* font) {
+    FGlyph* table = ffont_glyph_table(font);
+    size_t path_data_length = 0;
+    for (uint16_t k = 0; k < font->glyph_table_length; ++k) {
+        size_t end = table[k].path_data_offset + table[k].path_data_length;
+        if (end > path_data_length) {
+            path_data_length = end;
+        }
+    }
+    return (uint8_t*)ffont_path_data(font) - (uint8_t*)font + path_data_length;
+}
+
+bool ffont_validate(const void* data, size_t size) {
+    FFont* font = (FFont*)data;
+    if (size < sizeof(FFont) || font->units_per_em <= 0) {
+        return false;
+    }
+    size_t header_size = sizeof(FFont)
+                       + font->glyph_index_length * sizeof(FGlyphRange)
+                       + font->glyph_table_length * sizeof(FGlyph);
+    if (header_size > size) {
+        return false;
+    }
+    FGlyphRange* index = ffont_glyph_index(font);
+    size_t glyph_count = 0;
+    for (uint16_t k = 0; k < font->glyph_index_length; ++k) {
+        if (index[k].end < index[k].begin) {
+            return false;
+        }
+        glyph_count += index[k].end - index[k].begin;
+    }
+    if (glyph_count > font->glyph_table_length) {
+        return false;
+    }
+    FGlyph* table = ffont_glyph_table(font);
+    uint8_t* path_data = ffont_path_data(font);
+    for (uint16_t k = 0; k < font->glyph_table_length; ++k) {
+        FGlyph* glyph = table + k;
+        if (glyph->path_data_offset + glyph->path_data_length > size - header_size ||
+            !fctx_path_validate(path_data + glyph->path_data_offset, glyph->path_data_length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ffont_pack(FFont* font, void* out) {
+    size_t header_size = (uint8_t*)ffont_path_data(font) - (uint8_t*)font;
+    memcpy(out, font, header_size);
+    FFont* packed = (FFont*)out;
+    FGlyph* src = ffont_glyph_table(font);
+    FGlyph* dst = ffont_glyph_table(packed);
+    uint8_t* path_data = ffont_path_data(packed);
+    size_t offset = 0;
+    for (uint16_t k = 0; k < font->glyph_table_length; ++k) {
+        uint16_t length = fpath_pack(ffont_glyph_outline(font, &src[k]), src[k].path_data_length, path_data + offset);
+        if (!length || offset + length > UINT16_MAX) {
+            return 0;
+        }
+        dst[k].path_data_offset = offset;
+        dst[k].path_data_length = length;
+        offset += length;
+    }
+    return header_size + offset;
+}
+
 #if 0
 void ffont_debug_log(FFont* font, uint8_t log_level) {
     if (log_level >= APP_LOG_LEVEL_WARNING && font == NULL) {
@@ -0,0 +1,301 @@
+
+#include "fglyphatlas.h"
+#include "fpaint.h"
+#include <stdlib.h>
+
+struct FGlyphMask {
+    FFont* font;
+    uint16_t code_point;
+    FPoint scale_from;
+    FPoint scale_to;
+    uint8_t phase;
+    bool coarse;
+    int16_t left;
+    int16_t top;
+    uint16_t width;
+    uint16_t height;
+    uint32_t last_used;
+    uint8_t data[];
+};
+
+static inline size_t fglyph_mask_size(const FGlyphMask* mask) {
+    return sizeof(FGlyphMask) + ((mask->width + 1) / 2) * mask->height;
+}
+
+FGlyphAtlas* fglyph_atlas_create(size_t budget) {
+    FGlyphAtlas* atlas = malloc(sizeof(FGlyphAtlas));
+    if (atlas) {
+        atlas->budget = budget;
+        atlas->size = 0;
+        atlas->clock = 0;
+        atlas->count = 0;
+        atlas->capacity = 0;
+        atlas->masks = NULL;
+    }
+    return atlas;
+}
+
+void fglyph_atlas_clear(FGlyphAtlas* atlas) {
+    for (uint16_t k = 0; k < atlas->count; ++k) {
+        free(atlas->masks[k]);
+    }
+    atlas->count = 0;
+    atlas->size = 0;
+}
+
+void fglyph_atlas_destroy(FGlyphAtlas* atlas) {
+    if (atlas) {
+        fglyph_atlas_clear(atlas);
+        free(atlas->masks);
+        free(atlas);
+    }
+}
+
+size_t fglyph_atlas_size(FGlyphAtlas* atlas) {
+    return atlas ? atlas->size : 0;
+}
+
+#ifdef PBL_COLOR
+
+static inline int32_t fglyph_floor_pixel(fixed_t value) {
+    return (value >= 0) ? value / FIXED_POINT_SCALE : -((FIXED_POINT_SCALE - 1 - value) / FIXED_POINT_SCALE);
+}
+
+/* Find the mask of a glyph drawn at the context's scale, phase and curve
+ * flattening. */
+static FGlyphMask* fglyph_atlas_find(FGlyphAtlas* atlas, FContext* fctx, FFont* font, uint16_t code_point,
+                                     uint8_t phase) {
+    FPoint from = fctx->transform_scale_from;
+    FPoint to = fctx->transform_scale_to;
+    for (uint16_t k = 0; k < atlas->count; ++k) {
+        FGlyphMask* mask = atlas->masks[k];
+        if (mask->code_point == code_point && mask->phase == phase && mask->coarse == fctx->coarse_curves &&
+            mask->scale_to.x == to.x && mask->scale_to.y == to.y &&
+            mask->scale_from.x == from.x && mask->scale_from.y == from.y && mask->font == font) {
+            return mask;
+        }
+    }
+    return NULL;
+}
+
+static void fglyph_atlas_evict_oldest(FGlyphAtlas* atlas) {
+    uint16_t oldest = 0;
+    for (uint16_t k = 1; k < atlas->count; ++k) {
+        if (atlas->masks[k]->last_used < atlas->masks[oldest]->last_used) {
+            oldest = k;
+        }
+    }
+    atlas->size -= fglyph_mask_size(atlas->masks[oldest]);
+    free(atlas->masks[oldest]);
+    atlas->masks[oldest] = atlas->masks[--atlas->count];
+}
+
+/*
+ * Take ownership of a mask, evicting older masks to make room for it.
+ * @return false if the mask does not fit, in which case the caller keeps it.
+ */
+static bool fglyph_atlas_insert(FGlyphAtlas* atlas, FGlyphMask* mask) {
+    size_t size = fglyph_mask_size(mask);
+    if (size > atlas->budget) {
+        return false;
+    }
+    while (atlas->count && atlas->size + size > atlas->budget) {
+        fglyph_atlas_evict_oldest(atlas);
+    }
+    if (atlas->count == atlas->capacity) {
+        uint16_t capacity = atlas->capacity ? atlas->capacity * 2 : 16;
+        FGlyphMask** masks = realloc(atlas->masks, capacity * sizeof(FGlyphMask*));
+        if (!masks) {
+            return false;
+        }
+        atlas->masks = masks;
+        atlas->capacity = capacity;
+    }
+    atlas->masks[atlas->count++] = mask;
+    atlas->size += size;
+    return true;
+}
+
+/*
+ * Rasterize one glyph at the current text scale of the context, with its
+ * origin at the given horizontal subpixel phase.
+ */
+static FGlyphMask* fglyph_mask_create(FContext* fctx, FFont* font, FGlyph* glyph, uint16_t code_point, uint8_t phase) {
+
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    void* path_data = ffont_glyph_outline(font, glyph);
+    if (!fctx_flatten_commands(fctx, &flat, FPointZero, path_data, glyph->path_data_length)) {
+        fflat_path_destroy(&flat);
+        return NULL;
+    }
+
+    fixed_t phase_x = phase * FIXED_POINT_SCALE / FGLYPH_ATLAS_X_PHASES;
+    int16_t left = 0, top = 0, width = 0, height = 0;
+    if (flat.count) {
+        // One extra column and row catch the coverage of the right and bottom
+        // edges, which may land in the pixel after their floor.
+        left = fglyph_floor_pixel(flat.min.x + phase_x);
+        top = fglyph_floor_pixel(flat.min.y);
+        width = fglyph_floor_pixel(flat.max.x + phase_x) - left + 2;
+        height = fglyph_floor_pixel(flat.max.y) - top + 2;
+    }
+
+    uint16_t stride = (width + 1) / 2;
+    FGlyphMask* mask = malloc(sizeof(FGlyphMask) + stride * height);
+    if (mask) {
+        mask->font = font;
+        mask->code_point = code_point;
+        mask->scale_from = fctx->transform_scale_from;
+        mask->scale_to = fctx->transform_scale_to;
+        mask->phase = phase;
+        mask->coarse = fctx->coarse_curves;
+        mask->left = left;
+        mask->top = top;
+        mask->width = width;
+        mask->height = height;
+        mask->last_used = 0;
+        if (flat.count) {
+            FContext mctx;
+            if (fctx_init_mask_context(&mctx, GSize(width, height))) {
+                FTransform transform = {
+                    FPoint(phase_x - INT_TO_FIXED(left), -INT_TO_FIXED(top)), 0
+                };
+                fctx_begin_fill(&mctx);
+                fctx_draw_flat_path(&mctx, &flat, &transform);
+                fctx_end_fill_mask(&mctx, mask->data, stride);
+                fctx_deinit_context(&mctx);
+            } else {
+                free(mask);
+                mask = NULL;
+            }
+        }
+    }
+    fflat_path_destroy(&flat);
+    return mask;
+}
+
+/* Pass each run of equal coverage in a row of a mask to the fill paint. */
+static void fglyph_mask_paint_row(const FPaint* paint, uint8_t* row_data, int32_t row, const uint8_t* src, int32_t x, int32_t i0, int32_t i1) {
+    uint8_t coverage = 0;
+    int32_t start = i0;
+    for (int32_t i = i0; i <= i1; ++i) {
+        uint8_t a = (src[i / 2] >> ((i & 1) * 4)) & 0x0f;
+        if (a != coverage) {
+            if (coverage) {
+                paint->span(paint, row_data, row, x + start, x + i - 1, coverage);
+            }
+            coverage = a;
+            start = i;
+        }
+    }
+    if (coverage) {
+        paint->span(paint, row_data, row, x + start, x + i1, coverage);
+    }
+}
+
+static void fglyph_mask_composite(FContext* fctx, GBitmap* fb, const FGlyphMask* mask, int32_t x, int32_t y) {
+
+    GColor8 s = fctx->fill_color;
+    uint16_t stride = (mask->width + 1) / 2;
+    int16_t height = gbitmap_get_bounds(fb).size.h;
+    for (int32_t j = 0; j < mask->height; ++j) {
+        int32_t row = y + j;
+        if (row < 0 || row >= height) {
+            continue;
+        }
+        GBitmapDataRowInfo fbRowInfo = gbitmap_get_data_row_info(fb, row);
+        int32_t i0 = (fbRowInfo.min_x > x) ? fbRowInfo.min_x - x : 0;
+        int32_t i1 = (fbRowInfo.max_x < x + mask->width - 1) ? fbRowInfo.max_x - x : mask->width - 1;
+        const uint8_t* src = mask->data + j * stride;
+        if (fctx->fill_paint) {
+            fglyph_mask_paint_row(fctx->fill_paint, fbRowInfo.data, row, src, x, i0, i1);
+            continue;
+        }
+        uint8_t* dest = fbRowInfo.data + x;
+        for (int32_t i = i0; i <= i1; ++i) {
+            uint8_t a = (src[i / 2] >> ((i & 1) * 4)) & 0x0f;
+            if (a) {
+                FCTX_STAT(fctx, pixels_blended, (a < 8) ? 1 : 0);
+                FCTX_STAT(fctx, pixels_solid, (a == 8) ? 1 : 0);
+                dest[i] = fctx_blend_over(dest[i], s, a);
+            }
+        }
+    }
+}
+
+void fctx_draw_string_atlas(FContext* fctx, FGlyphAtlas* atlas, const char* text, FFont* font,
+                            GTextAlignment alignment, FTextAnchor anchor) {
+
+    if (!atlas || fctx->mode != FContextModeAA || fctx->occlusion) {
+        fctx_begin_fill(fctx);
+        fctx_draw_string(fctx, text, font, alignment, anchor);
+        fctx_end_fill(fctx);
+        return;
+    }
+
+    FPoint advance = fctx_string_origin(text, font, alignment, anchor);
+    FPoint scale_from = fctx->transform_scale_from;
+    FPoint scale_to = fctx->transform_scale_to;
+    fixed_t origin_y = advance.y * scale_to.y / scale_from.y + fctx->transform_offset.y + fctx->subpixel_adjust;
+    int32_t y = fglyph_floor_pixel(origin_y + FIXED_POINT_SCALE / 2);
+    uint16_t code_point;
+    uint16_t decode_state = 0;
+
+    ++atlas->clock;
+    GBitmap* fb = fctx_capture_target(fctx);
+    if (!fb) {
+        return;
+    }
+
+    for (const char* p = text; *p; ++p) {
+        if (0 == utf8_decode_byte(*p, &decode_state, &code_point)) {
+            FGlyph* glyph = ffont_glyph_info(font, code_point);
+            if (!glyph) {
+                continue;
+            }
+            if (glyph->path_data_length & FFONT_GLYPH_PENDING) {
+                advance.x += FIXED16_TO_FIXED(glyph->horiz_adv_x);
+                continue;
+            }
+
+            // Round the glyph origin to the nearest cached phase.
+            fixed_t origin_x = advance.x * scale_to.x / scale_from.x + fctx->transform_offset.x + fctx->subpixel_adjust;
+            int32_t x = fglyph_floor_pixel(origin_x);
+            fixed_t fraction = origin_x - INT_TO_FIXED(x);
+            uint8_t phase = (fraction * FGLYPH_ATLAS_X_PHASES + FIXED_POINT_SCALE / 2) / FIXED_POINT_SCALE;
+            if (phase == FGLYPH_ATLAS_X_PHASES) {
+                phase = 0;
+                ++x;
+            }
+
+            FGlyphMask* mask = fglyph_atlas_find(atlas, fctx, font, code_point, phase);
+            bool owned = false;
+            if (!mask) {
+                mask = fglyph_mask_create(fctx, font, glyph, code_point, phase);
+                owned = mask && !fglyph_atlas_insert(atlas, mask);
+            }
+            if (mask) {
+                mask->last_used = atlas->clock;
+                fglyph_mask_composite(fctx, fb, mask, x + mask->left, y + mask->top);
+                if (owned) {
+                    free(mask);
+                }
+            }
+            advance.x += FIXED16_TO_FIXED(glyph->horiz_adv_x);
+        }
+    }
+
+    fctx_release_target(fctx, fb);
+}
+
+#else
+
+void fctx_draw_string_atlas(FContext* fctx, FGlyphAtlas* atlas, const char* text, FFont* font,
+                            GTextAlignment alignment, FTextAnchor anchor) {
+    fctx_begin_fill(fctx);
+    fctx_draw_string(fctx, text, font, alignment, anchor);
+    fctx_end_fill(fctx);
+}
+
+#endif
@@ -0,0 +1,186 @@
+
+#include "fpaint.h"
+#include "fdither.h"
+
+#define FPAINT_ONE 65536
+
+const uint8_t fdither_bayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+static inline int32_t fpaint_clamp_t(int32_t t) {
+    if (t < 0) return 0;
+    if (t > FPAINT_ONE) return FPAINT_ONE;
+    return t;
+}
+
+#ifdef PBL_COLOR
+
+/* Interpolate a 2-bit channel at t, and dither the result back to 2 bits. */
+static inline uint8_t fpaint_dither_channel(int32_t a, int32_t b, int32_t t, uint8_t threshold) {
+    int32_t v = a * 16 + (((b - a) * 16 * t) >> 16);
+    return (v + threshold) / 16;
+}
+
+static inline void fpaint_put(uint8_t* row_data, int16_t x, GColor8 s, uint8_t coverage) {
+    if (coverage >= 8 && s.a == 3) {
+        row_data[x] = s.argb;
+    } else {
+        row_data[x] = fctx_blend_over(row_data[x], s, coverage);
+    }
+}
+
+static inline void fpaint_put_gradient(uint8_t* row_data, int16_t x, int16_t row, GColor8 c0, GColor8 c1, int32_t t, uint8_t coverage) {
+    uint8_t threshold = fdither_bayer[row & 3][x & 3];
+    GColor8 s;
+    s.a = 3;
+    s.r = fpaint_dither_channel(c0.r, c1.r, t, threshold);
+    s.g = fpaint_dither_channel(c0.g, c1.g, t, threshold);
+    s.b = fpaint_dither_channel(c0.b, c1.b, t, threshold);
+    fpaint_put(row_data, x, s, coverage);
+}
+
+#else
+
+static inline void fpaint_put_bit(uint8_t* row_data, int16_t x, bool white) {
+    uint8_t mask = 1 << (x % 8);
+    if (white) {
+        row_data[x / 8] |= mask;
+    } else {
+        row_data[x / 8] &= ~mask;
+    }
+}
+
+/* Interpolate the brightness of two colors at t, and dither it to a bit. */
+static inline void fpaint_put_gradient(uint8_t* row_data, int16_t x, int16_t row, GColor8 c0, GColor8 c1, int32_t t, uint8_t coverage) {
+    int32_t g0 = (c0.r + c0.g + c0.b) * 16 / 3;
+    int32_t g1 = (c1.r + c1.g + c1.b) * 16 / 3;
+    int32_t v = g0 + (((g1 - g0) * t) >> 16);
+    fpaint_put_bit(row_data, x, v > fdither_bayer[row & 3][x & 3] * 3);
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+// Linear gradient
+// --------------------------------------------------------------------------
+
+static void fpaint_linear_span(const FPaint* paint, uint8_t* row_data, int16_t row, int16_t x0, int16_t x1, uint8_t coverage) {
+    int32_t t = paint->linear.t0 + x0 * paint->linear.tx + row * paint->linear.ty;
+    for (int16_t x = x0; x <= x1; ++x, t += paint->linear.tx) {
+        fpaint_put_gradient(row_data, x, row, paint->linear.c0, paint->linear.c1, fpaint_clamp_t(t), coverage);
+    }
+}
+
+void fpaint_init_linear_gradient(FPaint* paint, FPoint p0, GColor c0, FPoint p1, GColor c1) {
+    // t = dot(p - p0, p1 - p0) / |p1 - p0|^2, sampled at pixel centers.
+    int64_t dx = p1.x - p0.x;
+    int64_t dy = p1.y - p0.y;
+    int64_t len2 = dx * dx + dy * dy;
+    if (len2 == 0) {
+        len2 = 1;
+    }
+    paint->span = &fpaint_linear_span;
+    paint->linear.tx = (dx * FIXED_POINT_SCALE * FPAINT_ONE) / len2;
+    paint->linear.ty = (dy * FIXED_POINT_SCALE * FPAINT_ONE) / len2;
+    paint->linear.t0 = ((FIXED_POINT_SCALE / 2 - p0.x) * dx + (FIXED_POINT_SCALE / 2 - p0.y) * dy) * FPAINT_ONE / len2;
+    paint->linear.c0 = c0;
+    paint->linear.c1 = c1;
+}
+
+// --------------------------------------------------------------------------
+// Radial gradient
+// --------------------------------------------------------------------------
+
+static uint32_t fpaint_isqrt(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// The shift from fixed point to quarter pixels.
+#define FPAINT_QUARTER_SHIFT (FIXED_POINT_SHIFT - 2)
+
+static void fpaint_radial_span(const FPaint* paint, uint8_t* row_data, int16_t row, int16_t x0, int16_t x1, uint8_t coverage) {
+    // Distances are tracked in quarter pixels.  A step of one pixel changes the
+    // distance by at most four, so the root is updated incrementally from one
+    // pixel to the next rather than recomputed.
+    int32_t ex = INT_TO_FIXED(x0) + FIXED_POINT_SCALE / 2 - paint->radial.center.x;
+    int32_t ey = INT_TO_FIXED(row) + FIXED_POINT_SCALE / 2 - paint->radial.center.y;
+    uint32_t ey2 = ((fixed_wide_t)ey * ey) >> (2 * FPAINT_QUARTER_SHIFT);
+    uint32_t radius = paint->radial.radius >> FPAINT_QUARTER_SHIFT;
+    uint32_t dist = fpaint_isqrt((((fixed_wide_t)ex * ex) >> (2 * FPAINT_QUARTER_SHIFT)) + ey2);
+    for (int16_t x = x0; x <= x1; ++x, ex += FIXED_POINT_SCALE) {
+        uint32_t d2 = (((fixed_wide_t)ex * ex) >> (2 * FPAINT_QUARTER_SHIFT)) + ey2;
+        while ((dist + 1) * (dist + 1) <= d2) {
+            ++dist;
+        }
+        while (dist * dist > d2) {
+            --dist;
+        }
+        int32_t t = (dist >= radius) ? FPAINT_ONE : (int32_t)((dist * paint->radial.inv_radius) >> 2);
+        fpaint_put_gradient(row_data, x, row, paint->radial.c0, paint->radial.c1, t, coverage);
+    }
+}
+
+void fpaint_init_radial_gradient(FPaint* paint, FPoint center, fixed_t radius, GColor c0, GColor c1) {
+    if (radius < 1) {
+        radius = 1;
+    }
+    paint->span = &fpaint_radial_span;
+    paint->radial.center = center;
+    paint->radial.radius = radius;
+    paint->radial.inv_radius = (1 << (16 + FIXED_POINT_SHIFT)) / radius;
+    paint->radial.c0 = c0;
+    paint->radial.c1 = c1;
+}
+
+// --------------------------------------------------------------------------
+// Bitmap pattern
+// --------------------------------------------------------------------------
+
+static inline int16_t fpaint_wrap(int32_t v, int16_t size) {
+    v %= size;
+    return (v < 0) ? v + size : v;
+}
+
+static void fpaint_pattern_span(const FPaint* paint, uint8_t* row_data, int16_t row, int16_t x0, int16_t x1, uint8_t coverage) {
+    GBitmap* bitmap = paint->pattern.bitmap;
+    GSize size = gbitmap_get_bounds(bitmap).size;
+    uint8_t* src = gbitmap_get_data(bitmap) +
+        fpaint_wrap(row - paint->pattern.origin.y, size.h) * gbitmap_get_bytes_per_row(bitmap);
+    int16_t u = fpaint_wrap(x0 - paint->pattern.origin.x, size.w);
+    for (int16_t x = x0; x <= x1; ++x) {
+#ifdef PBL_COLOR
+        GColor8 s;
+        s.argb = src[u];
+        fpaint_put(row_data, x, s, coverage);
+#else
+        fpaint_put_bit(row_data, x, src[u / 8] & (1 << (u % 8)));
+#endif
+        if (++u == size.w) {
+            u = 0;
+        }
+    }
+}
+
+void fpaint_init_pattern(FPaint* paint, GBitmap* bitmap, GPoint origin) {
+    paint->span = &fpaint_pattern_span;
+    paint->pattern.bitmap = bitmap;
+    paint->pattern.origin = origin;
+}
@@ -0,0 +1,403 @@
+
+#include "fpath.h"
+#include <stdlib.h>
+#include <string.h>
+
+FPath* fpath_load_from_resource_into_buffer(uint32_t resource_id, void* buffer) {
+    ResHandle rh = resource_get_handle(resource_id);
+    size_t rs = resource_size(rh);
+    FPath* fpath = (FPath*)buffer;
+    fpath->size = rs;
+    fpath->data = buffer + sizeof(FPath);
+    resource_load(rh, fpath->data, rs);
+    return fpath;
+}
+
+FPath* fpath_create_from_resource(uint32_t resource_id) {
+    ResHandle rh = resource_get_handle(resource_id);
+    size_t rs = resource_size(rh);
+    void* buffer = malloc(sizeof(FPath) + rs);
+    if (buffer) {
+        return fpath_load_from_resource_into_buffer(resource_id, buffer);
+    }
+    return NULL;
+}
+
+void fpath_destroy(FPath* fpath) {
+    free(fpath);
+}
+
+// --------------------------------------------------------------------------
+// Packed path data.
+// --------------------------------------------------------------------------
+
+static void fpath_pack_delta(uint8_t** data, fixed16_t prev, fixed16_t v) {
+    int32_t d = (fixed16_t)(v - prev);
+    uint32_t u = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    while (u >= 0x80) {
+        *(*data)++ = (uint8_t)(u | 0x80);
+        u >>= 7;
+    }
+    *(*data)++ = (uint8_t)u;
+}
+
+uint16_t fpath_pack(const void* path_data, uint16_t length, void* out) {
+    uint8_t* data = out;
+    uint8_t* cmd = NULL;
+    char prev = 0;
+    fixed16_t x = 0, y = 0, init_x = 0, init_y = 0;
+    FPathCursor cursor;
+    fixed16_t params[6];
+    char code;
+
+    *data++ = FCTX_PACKED_PATH_MAGIC;
+    fctx_path_cursor_init(&cursor, path_data, length);
+    while ((code = fctx_path_cursor_next(&cursor, params))) {
+        if (code == prev && (*cmd >> 4) < FCTX_PACKED_PATH_MAX_REPEAT - 1) {
+            *cmd += 0x10;
+        } else {
+            cmd = data++;
+            *cmd = strchr(FCTX_PACKED_PATH_CODES, code) - FCTX_PACKED_PATH_CODES;
+            prev = code;
+        }
+        if (code == 'Z') {
+            x = init_x;
+            y = init_y;
+        } else if (code == 'H') {
+            fpath_pack_delta(&data, x, params[0]);
+            x = params[0];
+        } else if (code == 'V') {
+            fpath_pack_delta(&data, y, params[0]);
+            y = params[0];
+        } else {
+            uint8_t count = (code == 'C') ? 6 : (code == 'S' || code == 'Q') ? 4 : 2;
+            for (uint8_t k = 0; k < count; k += 2) {
+                fpath_pack_delta(&data, x, params[k]);
+                fpath_pack_delta(&data, y, params[k + 1]);
+                x = params[k];
+                y = params[k + 1];
+            }
+            if (code == 'M') {
+                init_x = x;
+                init_y = y;
+            }
+        }
+    }
+    size_t size = data - (uint8_t*)out;
+    return (size > UINT16_MAX) ? 0 : size;
+}
+
+// --------------------------------------------------------------------------
+// Level of detail.
+// --------------------------------------------------------------------------
+
+/*
+ * A segment of a path, in absolute coordinates: 'M' and 'L' use p[0], 'C'
+ * uses p[0] to p[2], and 'Z' uses none.  The smooth and quadratic commands
+ * are converted to 'C' the same way as fctx_draw_commands converts them.
+ */
+typedef struct FPathSegment {
+    char code;
+    FPoint p[3];
+} FPathSegment;
+
+typedef struct FPathReader {
+    FPathCursor cursor;
+    FPoint initpt;
+    FPoint curpt;
+    FPoint ctrlpt;
+} FPathReader;
+
+static void fpath_reader_init(FPathReader* r, const void* data, uint16_t size) {
+    fctx_path_cursor_init(&r->cursor, data, size);
+    r->initpt = FPointZero;
+    r->curpt = FPointZero;
+    r->ctrlpt = FPointZero;
+}
+
+static bool fpath_read_segment(FPathReader* r, FPathSegment* seg) {
+    fixed16_t params[6];
+    char code = fctx_path_cursor_next(&r->cursor, params);
+    if (!code) {
+        return false;
+    }
+    const fixed16_t* param = params;
+    FPoint* p = seg->p;
+    switch (code) {
+        case 'M':
+        case 'L':
+            seg->code = code;
+            p[0].x = FIXED16_TO_FIXED(*param++);
+            p[0].y = FIXED16_TO_FIXED(*param++);
+            if (code == 'M') {
+                r->initpt = p[0];
+            }
+            break;
+        case 'Z':
+            seg->code = 'Z';
+            p[0] = r->initpt;
+            break;
+        case 'H':
+            seg->code = 'L';
+            p[0].x = FIXED16_TO_FIXED(*param++);
+            p[0].y = r->curpt.y;
+            break;
+        case 'V':
+            seg->code = 'L';
+            p[0].x = r->curpt.x;
+            p[0].y = FIXED16_TO_FIXED(*param++);
+            break;
+        case 'C':
+        case 'S':
+            seg->code = 'C';
+            if (code == 'C') {
+                p[0].x = FIXED16_TO_FIXED(*param++);
+                p[0].y = FIXED16_TO_FIXED(*param++);
+            } else {
+                p[0].x = r->curpt.x - r->ctrlpt.x + r->curpt.x;
+                p[0].y = r->curpt.y - r->ctrlpt.y + r->curpt.y;
+            }
+            p[1].x = FIXED16_TO_FIXED(*param++);
+            p[1].y = FIXED16_TO_FIXED(*param++);
+            p[2].x = FIXED16_TO_FIXED(*param++);
+            p[2].y = FIXED16_TO_FIXED(*param++);
+            r->ctrlpt = p[1];
+            break;
+        case 'Q':
+        case 'T':
+            seg->code = 'C';
+            if (code == 'Q') {
+                r->ctrlpt.x = FIXED16_TO_FIXED(*param++);
+                r->ctrlpt.y = FIXED16_TO_FIXED(*param++);
+            } else {
+                r->ctrlpt.x = r->curpt.x - r->ctrlpt.x + r->curpt.x;
+                r->ctrlpt.y = r->curpt.y - r->ctrlpt.y + r->curpt.y;
+            }
+            p[2].x = FIXED16_TO_FIXED(*param++);
+            p[2].y = FIXED16_TO_FIXED(*param++);
+            p[0].x = (r->curpt.x + 2 * r->ctrlpt.x) / 3;
+            p[0].y = (r->curpt.y + 2 * r->ctrlpt.y) / 3;
+            p[1].x = (p[2].x + 2 * r->ctrlpt.x) / 3;
+            p[1].y = (p[2].y + 2 * r->ctrlpt.y) / 3;
+            break;
+        default:
+            return false;
+    }
+    r->curpt = (seg->code == 'C') ? p[2] : p[0];
+    return true;
+}
+
+/* Whether p is within tolerance of the segment a-b. */
+static bool fpath_near_segment(FPoint p, FPoint a, FPoint b, fixed_t tolerance) {
+    int64_t dx = b.x - a.x;
+    int64_t dy = b.y - a.y;
+    int64_t px = p.x - a.x;
+    int64_t py = p.y - a.y;
+    int64_t len2 = dx * dx + dy * dy;
+    int64_t t2 = (int64_t)tolerance * tolerance;
+    int64_t dot = px * dx + py * dy;
+    if (len2 == 0 || dot <= 0) {
+        return px * px + py * py <= t2;
+    }
+    if (dot >= len2) {
+        int64_t qx = p.x - b.x;
+        int64_t qy = p.y - b.y;
+        return qx * qx + qy * qy <= t2;
+    }
+    int64_t cross = px * dy - py * dx;
+    return cross * cross <= t2 * len2;
+}
+
+#define FPATH_LOD_RUN_LENGTH 8
+
+/*
+ * Writes a simplified command stream.  Lines are held back while the points
+ * they pass through stay within tolerance of a single line from the anchor,
+ * the last point written.
+ */
+typedef struct FPathWriter {
+    uint8_t* data;
+    fixed_t tolerance;
+    FPoint anchor;
+    bool pending;
+    FPoint pending_pt;
+    uint8_t run_count;
+    FPoint run[FPATH_LOD_RUN_LENGTH];
+} FPathWriter;
+
+static void fpath_write_command(FPathWriter* w, char code, uint8_t count, const FPoint* p) {
+    uint16_t c = code;
+    memcpy(w->data, &c, sizeof c);
+    w->data += sizeof c;
+    for (uint8_t k = 0; k < count; ++k) {
+        fixed16_t v[2] = { FIXED_TO_FIXED16(p[k].x), FIXED_TO_FIXED16(p[k].y) };
+        memcpy(w->data, v, sizeof v);
+        w->data += sizeof v;
+    }
+}
+
+static void fpath_flush_line(FPathWriter* w) {
+    if (w->pending) {
+        fpath_write_command(w, 'L', 1, &w->pending_pt);
+        w->anchor = w->pending_pt;
+        w->pending = false;
+    }
+    w->run_count = 0;
+}
+
+static void fpath_write_line(FPathWriter* w, FPoint q) {
+    if (!w->pending) {
+        if (q.x != w->anchor.x || q.y != w->anchor.y) {
+            w->pending = true;
+            w->pending_pt = q;
+        }
+        return;
+    }
+    bool merge = w->run_count < FPATH_LOD_RUN_LENGTH &&
+                 fpath_near_segment(w->pending_pt, w->anchor, q, w->tolerance);
+    for (uint8_t k = 0; merge && k < w->run_count; ++k) {
+        merge = fpath_near_segment(w->run[k], w->anchor, q, w->tolerance);
+    }
+    if (merge) {
+        w->run[w->run_count++] = w->pending_pt;
+        w->pending_pt = q;
+    } else {
+        fpath_flush_line(w);
+        fpath_write_line(w, q);
+    }
+}
+
+/*
+ * Simplify the path with the tolerance.
+ * @return the size of the simplified path, which is at most 14 bytes per
+ * command of the original, and so may be more than a path can hold.
+ */
+static size_t fpath_simplify(const FPath* path, fixed_t tolerance, uint8_t* out) {
+
+    FPathWriter w = { .data = out, .tolerance = tolerance };
+    FPathReader r;
+    FPathSegment seg;
+    fpath_reader_init(&r, path->data, path->size);
+
+    while (fpath_read_segment(&r, &seg)) {
+        if (seg.code == 'M') {
+            // Find the bounds of the subpath, and drop it if it is too small
+            // to be seen.
+            FPathReader end = r;
+            FPathReader scan = r;
+            FPathSegment s;
+            FPoint lo = seg.p[0];
+            FPoint hi = seg.p[0];
+            while (fpath_read_segment(&scan, &s) && s.code != 'M') {
+                for (uint8_t k = 0; k < ((s.code == 'C') ? 3 : 1); ++k) {
+                    if (s.p[k].x < lo.x) lo.x = s.p[k].x;
+                    if (s.p[k].y < lo.y) lo.y = s.p[k].y;
+                    if (s.p[k].x > hi.x) hi.x = s.p[k].x;
+                    if (s.p[k].y > hi.y) hi.y = s.p[k].y;
+                }
+                end = scan;
+            }
+            fpath_flush_line(&w);
+            if (hi.x - lo.x <= tolerance && hi.y - lo.y <= tolerance) {
+                r = end;
+                continue;
+            }
+            fpath_write_command(&w, 'M', 1, seg.p);
+            w.anchor = seg.p[0];
+        } else if (seg.code == 'L') {
+            fpath_write_line(&w, seg.p[0]);
+        } else if (seg.code == 'C') {
+            FPoint a = w.pending ? w.pending_pt : w.anchor;
+            if (fpath_near_segment(seg.p[0], a, seg.p[2], tolerance) &&
+                fpath_near_segment(seg.p[1], a, seg.p[2], tolerance)) {
+                fpath_write_line(&w, seg.p[2]);
+            } else {
+                fpath_flush_line(&w);
+                fpath_write_command(&w, 'C', 3, seg.p);
+                w.anchor = seg.p[2];
+            }
+        } else /* seg.code == 'Z' */ {
+            fpath_flush_line(&w);
+            fpath_write_command(&w, 'Z', 0, NULL);
+            w.anchor = seg.p[0];
+        }
+    }
+    fpath_flush_line(&w);
+    return w.data - out;
+}
+
+FPathLOD* fpath_create_lod(const FPath* path, uint8_t max_levels) {
+
+    FPathLOD* lod = malloc(sizeof(FPathLOD));
+    if (!lod) {
+        return NULL;
+    }
+    lod->path = path;
+    lod->count = 1;
+    lod->levels[0].tolerance = 0;
+    lod->levels[0].size = path->size;
+    lod->levels[0].data = path->data;
+    if (max_levels > FPATH_LOD_MAX_LEVELS) {
+        max_levels = FPATH_LOD_MAX_LEVELS;
+    }
+
+    // Every command is written as at most 14 bytes.
+    size_t commands = 0;
+    {
+        FPathCursor cursor;
+        fixed16_t params[6];
+        fctx_path_cursor_init(&cursor, path->data, path->size);
+        while (fctx_path_cursor_next(&cursor, params)) {
+            ++commands;
+        }
+    }
+    uint8_t* scratch = malloc(commands * 14);
+    if (!scratch) {
+        free(lod);
+        return NULL;
+    }
+    for (uint8_t shift = 1; shift <= FPATH_LOD_MAX_SHIFT && lod->count < max_levels; ++shift) {
+        fixed_t tolerance = FPATH_LOD_ERROR << shift;
+        size_t size = fpath_simplify(path, tolerance, scratch);
+        if (size > UINT16_MAX || size >= lod->levels[lod->count - 1].size) {
+            continue;
+        }
+        void* data = malloc(size);
+        if (!data) {
+            break;
+        }
+        memcpy(data, scratch, size);
+        FPathLevel* level = &lod->levels[lod->count++];
+        level->tolerance = tolerance;
+        level->size = size;
+        level->data = data;
+    }
+    free(scratch);
+    return lod;
+}
+
+void fpath_destroy_lod(FPathLOD* lod) {
+    if (lod) {
+        for (uint8_t k = 1; k < lod->count; ++k) {
+            free(lod->levels[k].data);
+        }
+        free(lod);
+    }
+}
+
+void fctx_draw_path_lod(FContext* fctx, const FPathLOD* lod, FPoint advance) {
+    fixed_t from_x = abs(fctx->transform_scale_from.x);
+    fixed_t from_y = abs(fctx->transform_scale_from.y);
+    fixed_t to_x = abs(fctx->transform_scale_to.x);
+    fixed_t to_y = abs(fctx->transform_scale_to.y);
+    uint8_t k = lod->count - 1;
+    while (k > 0) {
+        int64_t tolerance = lod->levels[k].tolerance;
+        if (tolerance * to_x <= (int64_t)FPATH_LOD_ERROR * from_x &&
+            tolerance * to_y <= (int64_t)FPATH_LOD_ERROR * from_y) {
+            break;
+        }
+        --k;
+    }
+    fctx_draw_commands(fctx, advance, lod->levels[k].data, lod->levels[k].size);
+}
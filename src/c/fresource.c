@@ -0,0 +1,324 @@
+
+#include "fresource.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void fresource_loader_destroy(struct FResourceLoader* loader);
+
+// Keep each resource word aligned; FPath holds a pointer.
+#define FRESOURCE_ALIGN(n) (((n) + 3) & ~3)
+
+static size_t fresource_item_size(const FResourceSpec* spec) {
+    size_t rs = resource_size(resource_get_handle(spec->resource_id));
+    if (spec->type == FResourceTypePath) {
+        rs += sizeof(FPath);
+    }
+    return FRESOURCE_ALIGN(rs);
+}
+
+static size_t fresource_header_size(uint16_t count) {
+    return FRESOURCE_ALIGN(sizeof(FResourceArena) + count * sizeof(FResourceArenaItem));
+}
+
+size_t fresource_arena_size(const FResourceSpec* specs, uint16_t count) {
+    size_t size = fresource_header_size(count);
+    for (uint16_t k = 0; k < count; ++k) {
+        size += fresource_item_size(specs + k);
+    }
+    return size;
+}
+
+static FResourceArena* fresource_arena_alloc(const FResourceSpec* specs, uint16_t count) {
+    size_t size = fresource_arena_size(specs, count);
+    FResourceArena* arena = malloc(size);
+    if (!arena) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "resource arena: %d bytes", (int)size);
+        return NULL;
+    }
+    arena->size = size;
+    arena->count = count;
+    arena->loader = NULL;
+    for (uint16_t k = 0; k < count; ++k) {
+        arena->items[k].type = specs[k].type;
+        arena->items[k].data = NULL;
+    }
+    return arena;
+}
+
+FResourceArena* fresource_arena_create(const FResourceSpec* specs, uint16_t count) {
+
+    FResourceArena* arena = fresource_arena_alloc(specs, count);
+    if (!arena) {
+        return NULL;
+    }
+
+    void* ptr = (void*)arena + fresource_header_size(count);
+    for (uint16_t k = 0; k < count; ++k) {
+        const FResourceSpec* spec = specs + k;
+        if (spec->type == FResourceTypeFont) {
+            arena->items[k].data = ffont_load_from_resource_into_buffer(spec->resource_id, ptr);
+        } else {
+            arena->items[k].data = fpath_load_from_resource_into_buffer(spec->resource_id, ptr);
+        }
+        ptr += fresource_item_size(spec);
+    }
+    return arena;
+}
+
+void fresource_arena_destroy(FResourceArena* arena) {
+    if (arena && arena->loader) {
+        fresource_loader_destroy(arena->loader);
+    }
+    free(arena);
+}
+
+FFont* fresource_arena_font(FResourceArena* arena, uint16_t index) {
+    return (arena && index < arena->count && arena->items[index].type == FResourceTypeFont)
+        ? (FFont*)arena->items[index].data : NULL;
+}
+
+FPath* fresource_arena_path(FResourceArena* arena, uint16_t index) {
+    return (arena && index < arena->count && arena->items[index].type == FResourceTypePath)
+        ? (FPath*)arena->items[index].data : NULL;
+}
+
+// --------------------------------------------------------------------------
+// Incremental loading.
+// --------------------------------------------------------------------------
+
+// The delay between chunks, which lets the app handle its other events.
+#define FRESOURCE_CHUNK_INTERVAL 10
+
+typedef struct FResourceLoader {
+    FResourceArena* arena;
+    AppTimer* timer;
+    FResourceLoaderHandlers handlers;
+    void* context;
+    size_t chunk_size;
+    size_t loaded;
+    size_t total;
+    uint16_t index;      // the resource being loaded
+    void* ptr;           // its place in the arena
+    size_t done;         // the number of its bytes loaded
+    size_t head;         // for a font, the size up to its path data, once known
+    uint16_t next_glyph; // for a font, the first glyph that may be pending
+    FResourceSpec specs[];
+} FResourceLoader;
+
+static void fresource_loader_destroy(FResourceLoader* loader) {
+    if (loader->timer) {
+        app_timer_cancel(loader->timer);
+    }
+    loader->arena->loader = NULL;
+    free(loader);
+}
+
+/* Clear the pending flag of the glyphs from next_glyph on whose outlines are
+ * loaded, stopping at the first that is not. */
+static void fresource_release_glyphs(FResourceLoader* loader, FFont* font, size_t path_data_loaded) {
+    FGlyph* table = (FGlyph*)((uint8_t*)font + sizeof(FFont) + font->glyph_index_length * sizeof(FGlyphRange));
+    while (loader->next_glyph < font->glyph_table_length) {
+        FGlyph* glyph = &table[loader->next_glyph];
+        uint16_t length = glyph->path_data_length & ~FFONT_GLYPH_PENDING;
+        if (glyph->path_data_offset + length > path_data_loaded) {
+            break;
+        }
+        glyph->path_data_length = length;
+        ++loader->next_glyph;
+    }
+}
+
+/* Load up to budget bytes of the current resource, and publish it, or the
+ * parts of it that can be used, in the arena.  Returns the bytes loaded. */
+static size_t fresource_load_step(FResourceLoader* loader, size_t budget) {
+
+    FResourceArena* arena = loader->arena;
+    const FResourceSpec* spec = &loader->specs[loader->index];
+    ResHandle rh = resource_get_handle(spec->resource_id);
+    size_t rs = resource_size(rh);
+    uint8_t* data = loader->ptr;
+    if (spec->type == FResourceTypePath) {
+        data += sizeof(FPath);
+    }
+
+    size_t n = rs - loader->done;
+    if (n > budget) {
+        n = budget;
+    }
+    resource_load_byte_range(rh, loader->done, data + loader->done, n);
+    loader->done += n;
+
+    if (spec->type == FResourceTypeFont) {
+        FFont* font = (FFont*)data;
+        if (!loader->head && loader->done >= sizeof(FFont)) {
+            loader->head = sizeof(FFont) + font->glyph_index_length * sizeof(FGlyphRange)
+                         + font->glyph_table_length * sizeof(FGlyph);
+            loader->next_glyph = 0;
+        }
+        if (loader->head && loader->done >= loader->head) {
+            if (!arena->items[loader->index].data) {
+                // The glyph table is in place: hold back every glyph, then
+                // publish the font.
+                FGlyph* table = (FGlyph*)(data + loader->head) - font->glyph_table_length;
+                for (uint16_t k = 0; k < font->glyph_table_length; ++k) {
+                    table[k].path_data_length |= FFONT_GLYPH_PENDING;
+                }
+                arena->items[loader->index].data = font;
+            }
+            // Glyphs are usually stored in order, so most are released as
+            // soon as they are loaded, and any others at the end.
+            size_t path_data_loaded = (loader->done < rs) ? loader->done - loader->head : (size_t)-1;
+            fresource_release_glyphs(loader, font, path_data_loaded);
+        }
+    }
+
+    if (loader->done == rs) {
+        if (spec->type == FResourceTypePath) {
+            FPath* fpath = (FPath*)loader->ptr;
+            fpath->size = rs;
+            fpath->data = data;
+            arena->items[loader->index].data = fpath;
+        }
+        loader->ptr += fresource_item_size(spec);
+        loader->done = 0;
+        loader->head = 0;
+        ++loader->index;
+    }
+    return n;
+}
+
+static void fresource_loader_tick(void* data) {
+
+    FResourceLoader* loader = (FResourceLoader*)data;
+    FResourceArena* arena = loader->arena;
+    loader->timer = NULL;
+
+    size_t budget = loader->chunk_size;
+    while (budget && loader->index < arena->count) {
+        size_t n = fresource_load_step(loader, budget);
+        budget -= n;
+        loader->loaded += n;
+    }
+
+    // Finish with the loader before calling the handlers, which may destroy
+    // the arena.
+    FResourceLoaderHandlers handlers = loader->handlers;
+    void* context = loader->context;
+    size_t loaded = loader->loaded;
+    size_t total = loader->total;
+    bool complete = loader->index == arena->count;
+    if (complete) {
+        fresource_loader_destroy(loader);
+    } else {
+        loader->timer = app_timer_register(FRESOURCE_CHUNK_INTERVAL, fresource_loader_tick, loader);
+    }
+
+    if (handlers.progress) {
+        handlers.progress(arena, loaded, total, context);
+    }
+    if (complete && handlers.complete) {
+        handlers.complete(arena, context);
+    }
+}
+
+FResourceArena* fresource_arena_load(const FResourceSpec* specs, uint16_t count, size_t chunk_size,
+                                     FResourceLoaderHandlers handlers, void* context) {
+
+    FResourceLoader* loader = malloc(sizeof(FResourceLoader) + count * sizeof(FResourceSpec));
+    FResourceArena* arena = loader ? fresource_arena_alloc(specs, count) : NULL;
+    if (!arena) {
+        free(loader);
+        return NULL;
+    }
+    memcpy(loader->specs, specs, count * sizeof(FResourceSpec));
+    loader->arena = arena;
+    loader->handlers = handlers;
+    loader->context = context;
+    loader->chunk_size = (chunk_size < FRESOURCE_MIN_CHUNK) ? FRESOURCE_MIN_CHUNK : chunk_size;
+    loader->loaded = 0;
+    loader->total = 0;
+    for (uint16_t k = 0; k < count; ++k) {
+        loader->total += resource_size(resource_get_handle(specs[k].resource_id));
+    }
+    loader->index = 0;
+    loader->ptr = (void*)arena + fresource_header_size(count);
+    loader->done = 0;
+    loader->head = 0;
+    loader->next_glyph = 0;
+    loader->timer = app_timer_register(FRESOURCE_CHUNK_INTERVAL, fresource_loader_tick, loader);
+    if (!loader->timer) {
+        free(loader);
+        free(arena);
+        return NULL;
+    }
+    arena->loader = loader;
+    return arena;
+}
+
+bool fresource_arena_is_loaded(const FResourceArena* arena) {
+    return arena && !arena->loader;
+}
+
+// --------------------------------------------------------------------------
+// Mapped resource files.
+// --------------------------------------------------------------------------
+
+#ifdef FCTX_HOST
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FResourceMap* fresource_map_file(const char* path, FResourceType type) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "%s: cannot open", path);
+        return NULL;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "%s: cannot map", path);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    bool valid = (type == FResourceTypeFont)
+               ? ffont_validate(data, size)
+               : size <= UINT16_MAX && fctx_path_validate(data, size);
+    FResourceMap* map = valid ? malloc(sizeof(FResourceMap)) : NULL;
+    if (!map) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, valid ? "%s: out of memory" : "%s: malformed resource", path);
+        munmap(data, size);
+        return NULL;
+    }
+    map->type = type;
+    map->size = size;
+    map->data = data;
+    map->path.size = size;
+    map->path.data = data;
+    return map;
+}
+
+void fresource_unmap(FResourceMap* map) {
+    if (map) {
+        munmap(map->data, map->size);
+        free(map);
+    }
+}
+
+FFont* fresource_map_font(FResourceMap* map) {
+    return (map && map->type == FResourceTypeFont) ? (FFont*)map->data : NULL;
+}
+
+FPath* fresource_map_path(FResourceMap* map) {
+    return (map && map->type == FResourceTypePath) ? &map->path : NULL;
+}
+
+#endif
@@ -3,17 +3,24 @@
 #include <pebble-fctx/fctx.h>
 #include <pebble-fctx/fpath.h>
 #include <pebble-fctx/ffont.h>
+#include <pebble-fctx/fresource.h>
 
 // --------------------------------------------------------------------------
 // Types and global variables.
 // --------------------------------------------------------------------------
 
 #define RESMEM 1
+#define STATICPATHS 1
+
+#if STATICPATHS
+// Generated by the flatten step in the wscript.
+#include "static_paths.h"
+#endif
 
 Window* g_window;
 Layer* g_layer;
 #if RESMEM
-void* g_resource_memory;
+FResourceArena* g_resources;
 #endif
 FFont* g_font;
 FPath* g_body;
@@ -40,6 +47,28 @@ static inline FPoint clockToCartesian(FPoint center, fixed_t radius, int32_t ang
     return pt;
 }
 
+/* Plot a bar of the given half width and half length, centered on the dial
+ * radius and turned to the angle, through the context's offset. */
+static void plotBar(FContext* fctx, fixed_t radius, fixed_t half_width, fixed_t half_length, int32_t angle) {
+    FPoint corners[4] = {
+        FPoint(-half_width, -radius - half_length),
+        FPoint( half_width, -radius - half_length),
+        FPoint( half_width, -radius + half_length),
+        FPoint(-half_width, -radius + half_length)
+    };
+    int32_t c = cos_lookup(angle);
+    int32_t s = sin_lookup(angle);
+    for (int k = 0; k < 4; ++k) {
+        FPoint p = corners[k];
+        corners[k].x = (p.x * c - p.y * s) / TRIG_MAX_RATIO;
+        corners[k].y = (p.x * s + p.y * c) / TRIG_MAX_RATIO;
+    }
+    fctx_transform_points(fctx, 4, corners, corners, FPointZero);
+    for (int k = 0; k < 4; ++k) {
+        fctx_plot_edge(fctx, &corners[k], &corners[(k + 1) % 4]);
+    }
+}
+
 // --------------------------------------------------------------------------
 // The main drawing function.
 // --------------------------------------------------------------------------
@@ -58,7 +87,6 @@ void on_layer_update(Layer* layer, GContext* ctx) {
 
     FContext fctx;
     fctx_init_context(&fctx, ctx);
-    fctx_set_color_bias(&fctx, 0);
     fctx_set_fill_color(&fctx, GColorBlack);
 
     /* Draw the pips. */
@@ -66,65 +94,81 @@ void on_layer_update(Layer* layer, GContext* ctx) {
     fixed_t dot_radius = INT_TO_FIXED(pip_size - 4) / 2;
     fixed_t pips_radius = INT_TO_FIXED(outer_radius) - INT_TO_FIXED(pip_size) / 2;
     fctx_begin_fill(&fctx);
-    fctx_set_pivot(&fctx, FPoint(0, pips_radius));
     fctx_set_offset(&fctx, center);
     for (int m = 0; m < 60; ++m) {
         int32_t angle = m * TRIG_MAX_ANGLE / 60;
         if (0 == m % 5) {
             fixed_t pipw = (m % 15 == 0) ? INT_TO_FIXED(2) : INT_TO_FIXED(1);
-            fctx_set_rotation(&fctx, angle);
-            fctx_move_to(&fctx, FPoint(-pipw, -bar_length / 2));
-            fctx_line_to(&fctx, FPoint( pipw, -bar_length / 2));
-            fctx_line_to(&fctx, FPoint( pipw,  bar_length / 2));
-            fctx_line_to(&fctx, FPoint(-pipw,  bar_length / 2));
-            fctx_close_path(&fctx);
+            plotBar(&fctx, pips_radius, pipw, bar_length / 2, angle);
         } else {
-            FPoint p = clockToCartesian(center, pips_radius, angle);
-            fctx_plot_circle(&fctx, &p, dot_radius);
+            FPoint p = clockToCartesian(FPointZero, pips_radius, angle);
+            fctx_draw_pie(&fctx, p, dot_radius, 0, TRIG_MAX_ANGLE);
         }
     }
     fctx_end_fill(&fctx);
 
-    /* Set up for drawing the hands. */
+    /* Set up for drawing the hands, scaled from the 180 unit design. */
     int16_t from_size = 90;
     int16_t to_size = outer_radius - pip_size;
-    fctx_set_scale(&fctx, FPoint(from_size, from_size), FPoint(to_size, to_size));
-    fctx_set_pivot(&fctx, FPointI(90, 90));
-    fctx_set_offset(&fctx, center);
-
-    /* Draw the hour hand. */
-    fctx_begin_fill(&fctx);
-    fctx_set_fill_color(&fctx, GColorDarkGray);
-    fctx_set_rotation(&fctx, hour_angle);
-    fctx_draw_commands(&fctx, FPointZero, g_hour->data, g_hour->size);
-    fctx_end_fill(&fctx);
-
-    /* Draw the minute hand. */
-    fctx_begin_fill(&fctx);
-    fctx_set_fill_color(&fctx, GColorBlack);
-    fctx_set_rotation(&fctx, minute_angle);
-    fctx_draw_commands(&fctx, FPointZero, g_minute->data, g_minute->size);
-    fctx_end_fill(&fctx);
-
-    /* Draw the body. */
-    fctx_begin_fill(&fctx);
-    fctx_set_fill_color(&fctx, GColorBlack);
-    fctx_set_rotation(&fctx, 0);
-    fctx_draw_commands(&fctx, FPointZero, g_body->data, g_body->size);
-    fctx_end_fill(&fctx);
+    fctx.transform_scale_from = FPoint(from_size, from_size);
+    fctx.transform_scale_to = FPoint(to_size, to_size);
+
+#if STATICPATHS
+    /* Draw the hands and body from the paths flattened at build time, which
+     * have the pivot moved to their origin. */
+    struct { const FStaticPath* path; GColor color; int32_t angle; } shapes[] = {
+        { &static_hour,   GColorDarkGray, hour_angle },
+        { &static_minute, GColorBlack,    minute_angle },
+        { &static_body,   GColorBlack,    0 }
+    };
+    for (unsigned k = 0; k < ARRAY_LENGTH(shapes); ++k) {
+        fctx_begin_fill(&fctx);
+        fctx_set_fill_color(&fctx, shapes[k].color);
+        fctx_draw_static_path(&fctx, shapes[k].path, &(FTransform){ center, shapes[k].angle });
+        fctx_end_fill(&fctx);
+    }
+#else
+    /* Draw the hands and body, flattened with the pivot (90, 90) of the
+     * design moved to their origin, and turned about the center. */
+    struct { FPath* path; GColor color; int32_t angle; } shapes[] = {
+        { g_hour,   GColorDarkGray, hour_angle },
+        { g_minute, GColorBlack,    minute_angle },
+        { g_body,   GColorBlack,    0 }
+    };
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    for (unsigned k = 0; k < ARRAY_LENGTH(shapes); ++k) {
+        if (!shapes[k].path) {
+            continue;
+        }
+        fflat_path_clear(&flat);
+        if (!fctx_flatten_commands(&fctx, &flat, FPointI(-90, -90), shapes[k].path->data, shapes[k].path->size)) {
+            continue;
+        }
+        fctx_begin_fill(&fctx);
+        fctx_set_fill_color(&fctx, shapes[k].color);
+        fctx_draw_flat_path(&fctx, &flat, &(FTransform){ center, shapes[k].angle });
+        fctx_end_fill(&fctx);
+    }
+    fflat_path_destroy(&flat);
+#endif
 
-    /* Draw the date. */
-    FPoint date_pos;
-    date_pos.x = center.x + INT_TO_FIXED( 5) * to_size / from_size;
-    date_pos.y = center.y + INT_TO_FIXED(48) * to_size / from_size;
-    fctx_begin_fill(&fctx);
-    fctx_set_text_em_height(&fctx, g_font, 30 * to_size / from_size);
-    fctx_set_fill_color(&fctx, GColorWhite);
-    fctx_set_pivot(&fctx, FPointZero);
-    fctx_set_offset(&fctx, date_pos);
-    fctx_set_rotation(&fctx, -5 * TRIG_MAX_ANGLE / (2*360));
-    fctx_draw_string(&fctx, date_string, g_font, GTextAlignmentCenter, FTextAnchorBaseline);
-    fctx_end_fill(&fctx);
+    /* Draw the date, slightly rotated. */
+    if (g_font) {
+        FFlatPath date;
+        fflat_path_init(&date);
+        fctx_set_text_em_height(&fctx, g_font, 30 * to_size / from_size);
+        if (fctx_flatten_string(&fctx, &date, date_string, g_font, GTextAlignmentCenter, FTextAnchorBaseline)) {
+            FPoint date_pos;
+            date_pos.x = center.x + INT_TO_FIXED( 5) * to_size / from_size;
+            date_pos.y = center.y + INT_TO_FIXED(48) * to_size / from_size;
+            fctx_begin_fill(&fctx);
+            fctx_set_fill_color(&fctx, GColorWhite);
+            fctx_draw_flat_path(&fctx, &date, &(FTransform){ date_pos, -5 * TRIG_MAX_ANGLE / (2 * 360) });
+            fctx_end_fill(&fctx);
+        }
+        fflat_path_destroy(&date);
+    }
 
     fctx_deinit_context(&fctx);
 }
@@ -138,39 +182,24 @@ void on_tick_timer(struct tm* tick_time, TimeUnits units_changed) {
     layer_mark_dirty(g_layer);
 }
 
+#if RESMEM
+void on_resources_progress(FResourceArena* arena, size_t loaded, size_t total, void* context) {
+    g_font = fresource_arena_font(arena, 0);
+#if !STATICPATHS
+    g_body = fresource_arena_path(arena, 1);
+    g_hour = fresource_arena_path(arena, 2);
+    g_minute = fresource_arena_path(arena, 3);
+#endif
+    layer_mark_dirty(g_layer);
+}
+#endif
+
 // --------------------------------------------------------------------------
 // Initialization and teardown.
 // --------------------------------------------------------------------------
 
 static void init() {
 
-#if RESMEM
-    size_t font_size = resource_size(resource_get_handle(RESOURCE_ID_NARROW_FFONT));
-    size_t body_size = sizeof(FPath) + resource_size(resource_get_handle(RESOURCE_ID_BODY_FPATH));
-    size_t hour_size = sizeof(FPath) + resource_size(resource_get_handle(RESOURCE_ID_HOUR_FPATH));
-    size_t minute_size = sizeof(FPath) + resource_size(resource_get_handle(RESOURCE_ID_MINUTE_FPATH));
-    size_t resource_size = font_size + body_size + hour_size + minute_size;
-    void* g_resource_memory = malloc(resource_size);
-    void* resptr = g_resource_memory;
-
-    g_font = ffont_load_from_resource_into_buffer(RESOURCE_ID_NARROW_FFONT, resptr);
-    resptr += font_size;
-
-    g_body = fpath_load_from_resource_into_buffer(RESOURCE_ID_BODY_FPATH, resptr);
-    resptr += body_size;
-
-    g_hour = fpath_load_from_resource_into_buffer(RESOURCE_ID_HOUR_FPATH, resptr);
-    resptr += hour_size;
-
-    g_minute = fpath_load_from_resource_into_buffer(RESOURCE_ID_MINUTE_FPATH, resptr);
-    resptr += minute_size;
-#else
-    g_font = ffont_create_from_resource(RESOURCE_ID_NARROW_FFONT);
-    g_body = fpath_create_from_resource(RESOURCE_ID_BODY_FPATH);
-    g_hour = fpath_create_from_resource(RESOURCE_ID_HOUR_FPATH);
-    g_minute = fpath_create_from_resource(RESOURCE_ID_MINUTE_FPATH);
-#endif
-
     g_window = window_create();
     window_set_background_color(g_window, GColorWhite);
     window_stack_push(g_window, true);
@@ -181,6 +210,29 @@ static void init() {
     layer_set_update_proc(g_layer, &on_layer_update);
     layer_add_child(window_layer, g_layer);
 
+#if RESMEM
+    static const FResourceSpec specs[] = {
+        { RESOURCE_ID_NARROW_FFONT, FResourceTypeFont },
+#if !STATICPATHS
+        { RESOURCE_ID_BODY_FPATH,   FResourceTypePath },
+        { RESOURCE_ID_HOUR_FPATH,   FResourceTypePath },
+        { RESOURCE_ID_MINUTE_FPATH, FResourceTypePath }
+#endif
+    };
+    // Load in the background, once the layer that the progress handler marks
+    // dirty exists, so that the face appears at once and the hands and date
+    // fill in as they are loaded.
+    g_resources = fresource_arena_load(specs, ARRAY_LENGTH(specs), 1024,
+        (FResourceLoaderHandlers){ .progress = on_resources_progress }, NULL);
+#else
+    g_font = ffont_create_from_resource(RESOURCE_ID_NARROW_FFONT);
+#if !STATICPATHS
+    g_body = fpath_create_from_resource(RESOURCE_ID_BODY_FPATH);
+    g_hour = fpath_create_from_resource(RESOURCE_ID_HOUR_FPATH);
+    g_minute = fpath_create_from_resource(RESOURCE_ID_MINUTE_FPATH);
+#endif
+#endif
+
     time_t now = time(NULL);
     g_local_time = *localtime(&now);
     tick_timer_service_subscribe(MINUTE_UNIT, &on_tick_timer);
@@ -192,7 +244,7 @@ static void deinit() {
     window_destroy(g_window);
     layer_destroy(g_layer);
 #if RESMEM
-    free(g_resource_memory);
+    fresource_arena_destroy(g_resources);
 #else
     fpath_destroy(g_minute);
     fpath_destroy(g_hour);
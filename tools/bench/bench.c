@@ -0,0 +1,904 @@
+
+// -----------------------------------------------------------------------------
+// Rendering benchmark and golden image regression suite.
+//
+// Renders a set of representative scenes through each rendering mode of the
+// platform the program was built for, reports the time per frame, per fill
+// and per pixel, and compares each frame with a checked-in golden image.
+// -----------------------------------------------------------------------------
+
+#include "pebble_host.h"
+#include "fctx.h"
+#include "ffont.h"
+#include "fpath.h"
+#include "fglyphatlas.h"
+#include "fpaint.h"
+#include "fresource.h"
+#include "static_paths.h"
+
+#define RESOURCE_ID_NARROW_FFONT 1
+#define RESOURCE_ID_BODY_FPATH   2
+#define RESOURCE_ID_HOUR_FPATH   3
+#define RESOURCE_ID_MINUTE_FPATH 4
+
+typedef struct Assets {
+    FFont* font;
+    FPath* body;
+    FPath* hour;
+    FPath* minute;
+    FPathLOD* body_lod;
+    FFont* packed_font;
+    FPath* packed_body;
+    FPath* packed_hour;
+    FPath* packed_minute;
+    FGlyphAtlas* atlas;
+    GBitmap* pattern;
+    GBitmap* layers[2];
+} Assets;
+
+typedef int (*scene_func)(FContext* fctx, Assets* assets);
+
+// --------------------------------------------------------------------------
+// Path construction.
+// --------------------------------------------------------------------------
+
+typedef struct PathBuilder {
+    uint16_t length;
+    uint8_t data[512];
+} PathBuilder;
+
+static void path_command(PathBuilder* pb, char code, int count, const fixed_t* params) {
+    uint16_t c = code;
+    memcpy(pb->data + pb->length, &c, sizeof c);
+    pb->length += sizeof c;
+    for (int k = 0; k < count; ++k) {
+        fixed16_t p = FIXED_TO_FIXED16(params[k]);
+        memcpy(pb->data + pb->length, &p, sizeof p);
+        pb->length += sizeof p;
+    }
+}
+
+static void path_rect(PathBuilder* pb, fixed_t x0, fixed_t y0, fixed_t x1, fixed_t y1) {
+    path_command(pb, 'M', 2, (fixed_t[]){ x0, y0 });
+    path_command(pb, 'L', 2, (fixed_t[]){ x1, y0 });
+    path_command(pb, 'L', 2, (fixed_t[]){ x1, y1 });
+    path_command(pb, 'L', 2, (fixed_t[]){ x0, y1 });
+    path_command(pb, 'Z', 0, NULL);
+}
+
+static void path_circle(PathBuilder* pb, fixed_t cx, fixed_t cy, fixed_t r) {
+    // 0.5523 is the control point distance for a quarter circle cubic bezier.
+    fixed_t k = r * 5523 / 10000;
+    path_command(pb, 'M', 2, (fixed_t[]){ cx, cy - r });
+    path_command(pb, 'C', 6, (fixed_t[]){ cx + k, cy - r, cx + r, cy - k, cx + r, cy });
+    path_command(pb, 'C', 6, (fixed_t[]){ cx + r, cy + k, cx + k, cy + r, cx, cy + r });
+    path_command(pb, 'C', 6, (fixed_t[]){ cx - k, cy + r, cx - r, cy + k, cx - r, cy });
+    path_command(pb, 'C', 6, (fixed_t[]){ cx - r, cy - k, cx - k, cy - r, cx, cy - r });
+    path_command(pb, 'Z', 0, NULL);
+}
+
+// --------------------------------------------------------------------------
+// Scenes.
+// --------------------------------------------------------------------------
+
+static const int k_bezel = PBL_IF_ROUND_ELSE(6, 2);
+
+static const int16_t k_pip_size = 6;
+
+/* The test-app clock face pips: 12 rotated bars and 48 dots, in one fill. */
+static void draw_pips(FContext* fctx) {
+
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    int16_t outer_radius = PBL_DISPLAY_WIDTH / 2 - k_bezel;
+    int16_t pip_size = k_pip_size;
+    fixed_t pips_radius = INT_TO_FIXED(outer_radius) - INT_TO_FIXED(pip_size) / 2;
+    FFlatPath flat;
+    fflat_path_init(&flat);
+
+    fctx_set_fill_color(fctx, GColorBlack);
+    fctx_begin_fill(fctx);
+    for (int m = 0; m < 60; ++m) {
+        int32_t angle = m * TRIG_MAX_ANGLE / 60;
+        PathBuilder pb = { 0 };
+        if (0 == m % 5) {
+            fixed_t pipw = (m % 15 == 0) ? INT_TO_FIXED(2) : INT_TO_FIXED(1);
+            fixed_t half = INT_TO_FIXED(pip_size) / 2;
+            path_rect(&pb, -pipw, -pips_radius - half, pipw, -pips_radius + half);
+            fflat_path_clear(&flat);
+            fctx_flatten_commands(fctx, &flat, FPointZero, pb.data, pb.length);
+            fctx_draw_flat_path(fctx, &flat, &(FTransform){ center, angle });
+        } else {
+            fixed_t x = center.x + sin_lookup(angle) * pips_radius / TRIG_MAX_RATIO;
+            fixed_t y = center.y - cos_lookup(angle) * pips_radius / TRIG_MAX_RATIO;
+            path_circle(&pb, 0, 0, INT_TO_FIXED(pip_size - 4) / 2);
+            fctx_set_offset(fctx, FPoint(x, y));
+            fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+        }
+    }
+    fctx_end_fill(fctx);
+    fflat_path_destroy(&flat);
+}
+
+/* The date, slightly rotated, at the scale of the hands. */
+static void draw_date(FContext* fctx, Assets* assets) {
+
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    int16_t outer_radius = PBL_DISPLAY_WIDTH / 2 - k_bezel;
+    int16_t from_size = 90;
+    int16_t to_size = outer_radius - k_pip_size;
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    fctx_set_text_em_height(fctx, assets->font, 30 * to_size / from_size);
+    fctx_flatten_string(fctx, &flat, "18", assets->font, GTextAlignmentCenter, FTextAnchorBaseline);
+    FPoint date_pos;
+    date_pos.x = center.x + INT_TO_FIXED( 5) * to_size / from_size;
+    date_pos.y = center.y + INT_TO_FIXED(48) * to_size / from_size;
+    fctx_begin_fill(fctx);
+    fctx_set_fill_color(fctx, GColorWhite);
+    fctx_draw_flat_path(fctx, &flat, &(FTransform){ date_pos, -5 * TRIG_MAX_ANGLE / (2 * 360) });
+    fctx_end_fill(fctx);
+
+    fflat_path_destroy(&flat);
+}
+
+/* The test-app hands at 10:08 and the date, in four fills. */
+static void draw_hands(FContext* fctx, Assets* assets) {
+
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    int16_t outer_radius = PBL_DISPLAY_WIDTH / 2 - k_bezel;
+    int16_t pip_size = k_pip_size;
+    FFlatPath flat;
+    fflat_path_init(&flat);
+
+    /* Hands, scaled from the 180 unit design and rotated about its center. */
+    int16_t from_size = 90;
+    int16_t to_size = outer_radius - pip_size;
+    fctx->transform_scale_from = FPoint(from_size, from_size);
+    fctx->transform_scale_to = FPoint(to_size, to_size);
+    FPoint pivot = FPoint(-INT_TO_FIXED(90), -INT_TO_FIXED(90));
+    struct { FPath* path; GColor color; int32_t angle; } hands[] = {
+        { assets->hour,   GColorDarkGray, (10 * 60 + 8) * TRIG_MAX_ANGLE / (12 * 60) },
+        { assets->minute, GColorBlack,    8 * TRIG_MAX_ANGLE / 60 },
+        { assets->body,   GColorBlack,    0 }
+    };
+    for (unsigned k = 0; k < ARRAY_LENGTH(hands); ++k) {
+        fflat_path_clear(&flat);
+        fctx_flatten_commands(fctx, &flat, pivot, hands[k].path->data, hands[k].path->size);
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, hands[k].color);
+        fctx_draw_flat_path(fctx, &flat, &(FTransform){ center, hands[k].angle });
+        fctx_end_fill(fctx);
+    }
+    fflat_path_destroy(&flat);
+    draw_date(fctx, assets);
+}
+
+/* The test-app hands at 10:08 and the date, with the hands drawn from the
+ * static paths generated by fctx-flatten. */
+static void draw_static_hands(FContext* fctx, Assets* assets) {
+
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    int16_t outer_radius = PBL_DISPLAY_WIDTH / 2 - k_bezel;
+    int16_t from_size = 90;
+    int16_t to_size = outer_radius - k_pip_size;
+    fctx->transform_scale_from = FPoint(from_size, from_size);
+    fctx->transform_scale_to = FPoint(to_size, to_size);
+    struct { const FStaticPath* path; GColor color; int32_t angle; } hands[] = {
+        { &static_hour,   GColorDarkGray, (10 * 60 + 8) * TRIG_MAX_ANGLE / (12 * 60) },
+        { &static_minute, GColorBlack,    8 * TRIG_MAX_ANGLE / 60 },
+        { &static_body,   GColorBlack,    0 }
+    };
+    for (unsigned k = 0; k < ARRAY_LENGTH(hands); ++k) {
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, hands[k].color);
+        fctx_draw_static_path(fctx, hands[k].path, &(FTransform){ center, hands[k].angle });
+        fctx_end_fill(fctx);
+    }
+    draw_date(fctx, assets);
+}
+
+/* The same pips as draw_pips, with each shape flattened once and drawn at
+ * every position by the instanced calls. */
+static void draw_pips_instanced(FContext* fctx) {
+
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    int16_t outer_radius = PBL_DISPLAY_WIDTH / 2 - k_bezel;
+    int16_t pip_size = k_pip_size;
+    fixed_t pips_radius = INT_TO_FIXED(outer_radius) - INT_TO_FIXED(pip_size) / 2;
+    fixed_t half = INT_TO_FIXED(pip_size) / 2;
+    FTransform bars[8];
+    FTransform dots[48];
+    int nbars = 0, ndots = 0;
+    for (int m = 0; m < 60; ++m) {
+        int32_t angle = m * TRIG_MAX_ANGLE / 60;
+        if (m % 15 == 0) {
+            continue;
+        } else if (m % 5 == 0) {
+            bars[nbars++] = (FTransform){ center, angle };
+        } else {
+            dots[ndots].offset.x = center.x + sin_lookup(angle) * pips_radius / TRIG_MAX_RATIO;
+            dots[ndots].offset.y = center.y - cos_lookup(angle) * pips_radius / TRIG_MAX_RATIO;
+            dots[ndots++].rotation = 0;
+        }
+    }
+
+    FFlatPath wide, narrow;
+    fflat_path_init(&wide);
+    fflat_path_init(&narrow);
+    PathBuilder pb = { 0 };
+    path_rect(&pb, -INT_TO_FIXED(2), -pips_radius - half, INT_TO_FIXED(2), -pips_radius + half);
+    fctx_flatten_commands(fctx, &wide, FPointZero, pb.data, pb.length);
+    pb.length = 0;
+    path_rect(&pb, -INT_TO_FIXED(1), -pips_radius - half, INT_TO_FIXED(1), -pips_radius + half);
+    fctx_flatten_commands(fctx, &narrow, FPointZero, pb.data, pb.length);
+    pb.length = 0;
+    path_circle(&pb, 0, 0, INT_TO_FIXED(pip_size - 4) / 2);
+
+    fctx_set_fill_color(fctx, GColorBlack);
+    fctx_begin_fill(fctx);
+    fctx_draw_flat_path_symmetric(fctx, &wide, &(FTransform){ center, 0 }, 4);
+    fctx_draw_flat_path_instances(fctx, &narrow, bars, nbars);
+    fctx_draw_commands_instances(fctx, FPointZero, pb.data, pb.length, dots, ndots);
+    fctx_end_fill(fctx);
+    fflat_path_destroy(&wide);
+    fflat_path_destroy(&narrow);
+}
+
+/* The test-app clock face at 10:08 on the 18th. */
+static int scene_clock(FContext* fctx, Assets* assets) {
+    draw_pips(fctx);
+    draw_hands(fctx, assets);
+    return 5;
+}
+
+/* The clock face with the hands drawn from static paths, which are
+ * flattened at a scale of one rather than at the scale of the frame. */
+static int scene_static(FContext* fctx, Assets* assets) {
+    draw_pips(fctx);
+    draw_static_hands(fctx, assets);
+    return 5;
+}
+
+/* The clock face with instanced pips.  The frame is the same as the clock
+ * scene. */
+static int scene_instanced(FContext* fctx, Assets* assets) {
+    draw_pips_instanced(fctx);
+    draw_hands(fctx, assets);
+    return 5;
+}
+
+/* The clock face drawn from packed copies of the paths and font.  The frame
+ * is the same as the clock scene. */
+static int scene_packed(FContext* fctx, Assets* assets) {
+    Assets packed = *assets;
+    packed.font = assets->packed_font;
+    packed.body = assets->packed_body;
+    packed.hour = assets->packed_hour;
+    packed.minute = assets->packed_minute;
+    return scene_clock(fctx, &packed);
+}
+
+/* The clock face with the pips rendered once into a layer and copied. */
+static int scene_layer(FContext* fctx, Assets* assets) {
+    GBitmap** layer = &assets->layers[fctx->mode];
+    if (!*layer) {
+        GBitmap* fb = fctx_capture_target(fctx);
+        GRect bounds = gbitmap_get_bounds(fb);
+        GBitmapFormat format = gbitmap_get_format(fb);
+        fctx_release_target(fctx, fb);
+        *layer = gbitmap_create_blank(bounds.size, format);
+#ifdef PBL_BW
+        // 1-bit layers are opaque, so start from the white background.
+        memset(gbitmap_get_data(*layer), 0xff, gbitmap_get_bytes_per_row(*layer) * bounds.size.h);
+#endif
+        FContext layer_fctx;
+        fctx_init_context_bitmap(&layer_fctx, *layer, fctx->mode);
+        draw_pips(&layer_fctx);
+        fctx_deinit_context(&layer_fctx);
+    }
+    fctx_draw_layer(fctx, *layer, GPointZero);
+    draw_hands(fctx, assets);
+    return 4;
+}
+
+/* The clock face through a context with a flag buffer of 13 rows.  The frame
+ * is the same as the clock scene. */
+static int scene_banded(FContext* fctx, Assets* assets) {
+    FContext banded;
+    fctx_init_context_banded(&banded, fctx->gctx, fctx->mode, 13);
+    int fills = scene_clock(&banded, assets);
+    fctx_deinit_context(&banded);
+    return fills;
+}
+
+/* Lines of small digits filling the screen. */
+static int scene_text(FContext* fctx, Assets* assets) {
+    int fills = 0;
+    int16_t em = 16;
+    fctx_set_text_em_height(fctx, assets->font, em);
+    for (int16_t y = em; y < PBL_DISPLAY_HEIGHT; y += em) {
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, (fills & 1) ? GColorBlack : GColorBlue);
+        fctx_set_offset(fctx, FPoint(INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2) + fills * FIX1 * 3 / 16, INT_TO_FIXED(y)));
+        fctx_draw_string(fctx, "0123456789012345", assets->font, GTextAlignmentCenter, FTextAnchorBaseline);
+        fctx_end_fill(fctx);
+        ++fills;
+    }
+    return fills;
+}
+
+/* The text scene composited from cached glyph masks. */
+static int scene_text_atlas(FContext* fctx, Assets* assets) {
+    int fills = 0;
+    int16_t em = 16;
+    fctx_set_text_em_height(fctx, assets->font, em);
+    for (int16_t y = em; y < PBL_DISPLAY_HEIGHT; y += em) {
+        fctx_set_fill_color(fctx, (fills & 1) ? GColorBlack : GColorBlue);
+        fctx_set_offset(fctx, FPoint(INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2) + fills * FIX1 * 3 / 16, INT_TO_FIXED(y)));
+        fctx_draw_string_atlas(fctx, assets->atlas, "0123456789012345", assets->font, GTextAlignmentCenter, FTextAnchorBaseline);
+        ++fills;
+    }
+    return fills;
+}
+
+/* The text scene after the first chunk of an incremental font load: the
+ * digits whose outlines are loaded are drawn, and the others leave gaps. */
+static int scene_loading(FContext* fctx, Assets* assets) {
+    static const FResourceSpec specs[] = {
+        { RESOURCE_ID_NARROW_FFONT, FResourceTypeFont }
+    };
+    FResourceArena* arena = fresource_arena_load(specs, ARRAY_LENGTH(specs), 768, (FResourceLoaderHandlers){ 0 }, NULL);
+    host_app_timer_run_next();
+    Assets loading = *assets;
+    loading.font = fresource_arena_font(arena, 0);
+    int fills = loading.font ? scene_text(fctx, &loading) : 0;
+    fresource_arena_destroy(arena);
+    return fills;
+}
+
+/* A radial gradient disc, a linear gradient band and patterned text. */
+static int scene_paint(FContext* fctx, Assets* assets) {
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    fixed_t radius = INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2 - k_bezel);
+    FPaint paint;
+    PathBuilder pb = { 0 };
+
+    path_circle(&pb, 0, 0, radius);
+    fpaint_init_radial_gradient(&paint, FPoint(center.x - radius / 3, center.y - radius / 3), radius * 3 / 2,
+                                GColorWhite, GColorBlue);
+    fctx_begin_fill(fctx);
+    fctx_set_offset(fctx, center);
+    fctx_set_fill_paint(fctx, &paint);
+    fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+    fctx_end_fill(fctx);
+
+    pb.length = 0;
+    path_rect(&pb, -radius, -INT_TO_FIXED(12), radius, INT_TO_FIXED(12));
+    fpaint_init_linear_gradient(&paint, FPoint(center.x - radius, center.y), GColorRed,
+                                FPoint(center.x + radius, center.y), GColorYellow);
+    fctx_begin_fill(fctx);
+    fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+    fctx_end_fill(fctx);
+
+    fpaint_init_pattern(&paint, assets->pattern, GPoint(0, 0));
+    fctx_begin_fill(fctx);
+    fctx_set_text_em_height(fctx, assets->font, 28);
+    fctx_set_offset(fctx, FPoint(center.x, center.y + INT_TO_FIXED(38)));
+    fctx_draw_string(fctx, "10:08", assets->font, GTextAlignmentCenter, FTextAnchorMiddle);
+    fctx_end_fill(fctx);
+
+    fctx_set_fill_color(fctx, GColorWhite);
+    return 3;
+}
+
+/* Concentric rings, each drawn as a pair of circles. */
+static int scene_circles(FContext* fctx, Assets* assets) {
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    fixed_t radius = INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2 - k_bezel);
+    GColor colors[] = { GColorRed, GColorBlack, GColorOrange, GColorDarkGray };
+    int fills = 0;
+    fctx_set_offset(fctx, center);
+    for (fixed_t r = radius; r > INT_TO_FIXED(8); r -= radius / 4) {
+        PathBuilder pb = { 0 };
+        path_circle(&pb, FIX1 / 3, FIX1 / 5, r);
+        path_circle(&pb, FIX1 / 3, FIX1 / 5, r - radius / 8);
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, colors[fills % ARRAY_LENGTH(colors)]);
+        fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+        fctx_end_fill(fctx);
+        ++fills;
+    }
+    return fills;
+}
+
+/* The body path at small sizes, through its levels of detail. */
+static int scene_lod(FContext* fctx, Assets* assets) {
+    static const int16_t sizes[] = { 56, 28, 14, 7 };
+    FPoint pivot = FPoint(-INT_TO_FIXED(90), -INT_TO_FIXED(90));
+    int fills = 0;
+    int16_t y = 8;
+    fctx->transform_scale_from = FPoint(180, 180);
+    for (unsigned k = 0; k < ARRAY_LENGTH(sizes); ++k) {
+        int16_t size = sizes[k];
+        fctx->transform_scale_to = FPoint(size, size);
+        for (int16_t x = 4; x + size <= PBL_DISPLAY_WIDTH - 4; x += size + 2) {
+            fctx_begin_fill(fctx);
+            fctx_set_fill_color(fctx, (fills & 1) ? GColorBlack : GColorBlue);
+            fctx_set_offset(fctx, FPointI(x + size / 2, y + size / 2));
+            fctx_draw_path_lod(fctx, assets->body_lod, pivot);
+            fctx_end_fill(fctx);
+            ++fills;
+        }
+        y += size + 2;
+    }
+    return fills;
+}
+
+/* A bar chart and gauges with subpixel edges, some of them off screen. */
+static int scene_rects(FContext* fctx, Assets* assets) {
+    GColor colors[] = { GColorRed, GColorBlack, GColorOrange, GColorDarkGray, GColorBlue };
+    fixed_t w = INT_TO_FIXED(PBL_DISPLAY_WIDTH);
+    fixed_t h = INT_TO_FIXED(PBL_DISPLAY_HEIGHT);
+    fixed_t base = h * 2 / 3;
+    fixed_t bar = (w - INT_TO_FIXED(16)) / 12;
+    FPaint paint;
+    int fills = 0;
+
+    /* A background band that overhangs the screen. */
+    fctx_set_fill_color(fctx, GColorLightGray);
+    fctx_fill_rect(fctx, FPoint(-INT_TO_FIXED(5), base - INT_TO_FIXED(3)), FPoint(w + INT_TO_FIXED(7), h + INT_TO_FIXED(9)));
+    ++fills;
+
+    /* Bars, with both corners given in either order. */
+    for (int k = 0; k < 12; ++k) {
+        fixed_t x0 = INT_TO_FIXED(8) + bar * k + k * FIX1 * 3 / 16;
+        fixed_t x1 = x0 + bar * 2 / 3 + k * FIX1 / 16;
+        fixed_t top = base - (INT_TO_FIXED(12) + k * k * INT_TO_FIXED(9) / 10 + k * FIX1 * 5 / 16);
+        fctx_set_fill_color(fctx, colors[k % ARRAY_LENGTH(colors)]);
+        if (k & 1) {
+            fctx_fill_rect(fctx, FPoint(x1, base), FPoint(x0, top));
+        } else {
+            fctx_fill_rect(fctx, FPoint(x0, top), FPoint(x1, base));
+        }
+        ++fills;
+    }
+
+    /* Gauges, one row per value, and a hairline under each. */
+    fixed_t y = base + INT_TO_FIXED(6);
+    for (int k = 0; k < 4 && y + INT_TO_FIXED(8) < h; ++k) {
+        fixed_t x1 = INT_TO_FIXED(10) + (w - INT_TO_FIXED(20)) * (k * 3 + 2) / 11 + k * FIX1 * 3 / 16;
+        fctx_set_fill_color(fctx, colors[(k + 2) % ARRAY_LENGTH(colors)]);
+        fctx_fill_rect(fctx, FPoint(INT_TO_FIXED(10) + k * FIX1 / 16, y + k * FIX1 * 5 / 16), FPoint(x1, y + INT_TO_FIXED(6) + k * FIX1 / 16));
+        fctx_set_fill_color(fctx, GColorBlack);
+        fctx_fill_rect(fctx, FPoint(INT_TO_FIXED(10), y + INT_TO_FIXED(7)), FPoint(w - INT_TO_FIXED(10), y + INT_TO_FIXED(7) + FIX1 / 3));
+        fills += 2;
+        y += INT_TO_FIXED(10) + FIX1 / 4;
+    }
+
+    /* A gradient strip along the top, through the generic path. */
+    fpaint_init_linear_gradient(&paint, FPoint(0, 0), GColorYellow, FPoint(w, 0), GColorRed);
+    fctx_set_fill_paint(fctx, &paint);
+    fctx_fill_rect(fctx, FPoint(INT_TO_FIXED(20) + FIX1 / 2, INT_TO_FIXED(4) + FIX1 * 5 / 16), FPoint(w - INT_TO_FIXED(20) - FIX1 * 3 / 16, INT_TO_FIXED(14)));
+    fctx_set_fill_color(fctx, GColorWhite);
+    return fills + 1;
+}
+
+/* Progress rings, a battery arc and pie sectors, one fill each. */
+static int scene_arcs(FContext* fctx, Assets* assets) {
+    GColor colors[] = { GColorRed, GColorOrange, GColorBlue, GColorDarkGray };
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    fixed_t radius = INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2 - k_bezel);
+    fixed_t width = radius / 8;
+    int fills = 0;
+
+    /* Rings at 80, 55, 30 and 100 percent, starting at 12 o'clock. */
+    static const int32_t percent[] = { 80, 55, 30, 100 };
+    for (unsigned k = 0; k < ARRAY_LENGTH(percent); ++k) {
+        fixed_t outer = radius - k * (width + INT_TO_FIXED(2) + FIX1 / 3);
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, colors[k]);
+        fctx_draw_ring_arc(fctx, center, outer, outer - width, 0, TRIG_MAX_ANGLE * percent[k] / 100);
+        fctx_end_fill(fctx);
+        ++fills;
+    }
+
+    /* A battery gauge across the bottom, with the angles reversed. */
+    fctx_begin_fill(fctx);
+    fctx_set_fill_color(fctx, GColorBlack);
+    fctx_draw_ring_arc(fctx, center, radius / 2, radius / 2 - INT_TO_FIXED(5),
+                       TRIG_MAX_ANGLE * 5 / 8, TRIG_MAX_ANGLE * 3 / 8 + 123);
+    fctx_end_fill(fctx);
+    ++fills;
+
+    /* Pie sectors, small and large, in the middle. */
+    fctx_begin_fill(fctx);
+    fctx_set_fill_color(fctx, GColorBlue);
+    fctx_draw_pie(fctx, FPoint(center.x - INT_TO_FIXED(12), center.y), radius / 4, -TRIG_MAX_ANGLE / 12, TRIG_MAX_ANGLE / 3);
+    fctx_draw_pie(fctx, FPoint(center.x + INT_TO_FIXED(14) + FIX1 / 2, center.y + FIX1 / 4), INT_TO_FIXED(9),
+                  TRIG_MAX_ANGLE / 2, TRIG_MAX_ANGLE * 7 / 4);
+    fctx_end_fill(fctx);
+    ++fills;
+    return fills;
+}
+
+/* Thin hands at many angles, one fill each. */
+static int scene_hands(FContext* fctx, Assets* assets) {
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    fixed_t length = INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2 - k_bezel);
+    PathBuilder pb = { 0 };
+    path_rect(&pb, -FIX1 / 2, -length, FIX1 / 2, INT_TO_FIXED(10));
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    fctx_flatten_commands(fctx, &flat, FPointZero, pb.data, pb.length);
+    int fills = 0;
+    for (int32_t angle = 0; angle < TRIG_MAX_ANGLE; angle += TRIG_MAX_ANGLE / 24 + 37) {
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, (fills & 1) ? GColorBlack : GColorRed);
+        fctx_draw_flat_path(fctx, &flat, &(FTransform){ center, angle });
+        fctx_end_fill(fctx);
+        ++fills;
+    }
+    fflat_path_destroy(&flat);
+    return fills;
+}
+
+/* One layer of a watch face, from the back (0) to the front (5): a gradient
+ * that covers the screen, a face disc over most of it, the pips, the hour and
+ * minute hands and a center cap. */
+static void draw_dial_layer(FContext* fctx, int layer) {
+    FPoint center = FPointI(PBL_DISPLAY_WIDTH / 2, PBL_DISPLAY_HEIGHT / 2);
+    fixed_t radius = INT_TO_FIXED(PBL_DISPLAY_WIDTH / 2 - k_bezel);
+    fixed_t face_radius = radius - INT_TO_FIXED(k_pip_size + 2);
+    PathBuilder pb = { 0 };
+    FFlatPath flat;
+    FPaint paint;
+
+    switch (layer) {
+    case 0:
+        path_rect(&pb, -center.x, -center.y, center.x, center.y);
+        fpaint_init_radial_gradient(&paint, center, radius, GColorYellow, GColorLightGray);
+        fctx_begin_fill(fctx);
+        fctx_set_offset(fctx, center);
+        fctx_set_fill_paint(fctx, &paint);
+        fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+        fctx_end_fill(fctx);
+        break;
+    case 1:
+        path_circle(&pb, 0, 0, face_radius);
+        fctx_begin_fill(fctx);
+        fctx_set_offset(fctx, center);
+        fctx_set_fill_color(fctx, GColorWhite);
+        fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+        fctx_end_fill(fctx);
+        break;
+    case 2:
+        draw_pips_instanced(fctx);
+        break;
+    case 3:
+    case 4:
+        path_rect(&pb, -INT_TO_FIXED(3), -face_radius * (layer == 3 ? 6 : 9) / 10, INT_TO_FIXED(3), INT_TO_FIXED(12));
+        fflat_path_init(&flat);
+        fctx_flatten_commands(fctx, &flat, FPointZero, pb.data, pb.length);
+        fctx_begin_fill(fctx);
+        fctx_set_fill_color(fctx, (layer == 3) ? GColorDarkGray : GColorBlack);
+        fctx_draw_flat_path(fctx, &flat, &(FTransform){ center, (layer == 3) ? TRIG_MAX_ANGLE * 302 / 360 : TRIG_MAX_ANGLE * 48 / 360 });
+        fctx_end_fill(fctx);
+        fflat_path_destroy(&flat);
+        break;
+    case 5:
+        path_circle(&pb, 0, 0, INT_TO_FIXED(7) + FIX1 / 2);
+        fctx_begin_fill(fctx);
+        fctx_set_offset(fctx, center);
+        fctx_set_fill_color(fctx, GColorRed);
+        fctx_draw_commands(fctx, FPointZero, pb.data, pb.length);
+        fctx_end_fill(fctx);
+        break;
+    }
+}
+
+static const int k_dial_layers = 6;
+
+/* A gradient bezel, a face, pips, hands and a cap, drawn back to front. */
+static int scene_dial(FContext* fctx, Assets* assets) {
+    for (int layer = 0; layer < k_dial_layers; ++layer) {
+        draw_dial_layer(fctx, layer);
+    }
+    return k_dial_layers;
+}
+
+/* The dial scene drawn front to back, so that each pixel is written once
+ * except at the edges. */
+static int scene_occlusion(FContext* fctx, Assets* assets) {
+    if (!fctx_begin_occlusion(fctx, GColorWhite)) {
+        return scene_dial(fctx, assets);
+    }
+    for (int layer = k_dial_layers - 1; layer >= 0; --layer) {
+        draw_dial_layer(fctx, layer);
+    }
+    fctx_end_occlusion(fctx);
+    return k_dial_layers;
+}
+
+/* The clock face through a context that flattens each curve into two
+ * chords, as when a frame budget is exceeded. */
+static int scene_coarse(FContext* fctx, Assets* assets) {
+    FContext coarse;
+    fctx_enable_coarse_curves(true);
+    fctx_init_context_mode(&coarse, fctx->gctx, fctx->mode);
+    fctx_enable_coarse_curves(false);
+    int fills = scene_clock(&coarse, assets);
+    fctx_deinit_context(&coarse);
+    return fills;
+}
+
+static const struct {
+    const char* name;
+    scene_func render;
+} k_scenes[] = {
+    { "clock",   scene_clock },
+    { "layer",   scene_layer },
+    { "banded",  scene_banded },
+    { "text",    scene_text },
+    { "atlas",   scene_text_atlas },
+    { "circles", scene_circles },
+    { "paint",   scene_paint },
+    { "hands",   scene_hands },
+    { "lod",     scene_lod },
+    { "rects",   scene_rects },
+    { "arcs",    scene_arcs },
+    { "instanced", scene_instanced },
+    { "packed",  scene_packed },
+    { "loading", scene_loading },
+    { "dial",    scene_dial },
+    { "occlusion", scene_occlusion },
+    { "coarse",  scene_coarse },
+    { "static",  scene_static }
+};
+
+// --------------------------------------------------------------------------
+// Benchmark driver.
+// --------------------------------------------------------------------------
+
+typedef struct Options {
+    const char* golden_dir;
+    const char* out_dir;
+    const char* resource_dir;
+    int iterations;
+    bool update;
+} Options;
+
+static int render_frame(GContext* gctx, FContextMode mode, Assets* assets, scene_func render) {
+    FContext fctx;
+    fctx_init_context_mode(&fctx, gctx, mode);
+    int fills = render(&fctx, assets);
+    fctx_deinit_context(&fctx);
+    return fills;
+}
+
+static int count_differences(const uint8_t* a, const uint8_t* b, int pixels) {
+    int count = 0;
+    for (int k = 0; k < pixels; ++k, a += 3, b += 3) {
+        if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2]) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/* Compare a frame with its golden image.  Returns the number of differing
+ * pixels, or -1 if there is no usable golden image. */
+static int check_golden(const Options* options, const char* name, const uint8_t* rgb) {
+
+    char path[512];
+    int w = PBL_DISPLAY_WIDTH, h = PBL_DISPLAY_HEIGHT;
+    snprintf(path, sizeof path, "%s/%s.png", options->golden_dir, name);
+    if (options->update) {
+        return host_png_write(path, w, h, rgb) ? 0 : -1;
+    }
+
+    int gw, gh;
+    uint8_t* golden = host_png_read(path, &gw, &gh);
+    int diff = -1;
+    if (golden && gw == w && gh == h) {
+        diff = count_differences(rgb, golden, w * h);
+    }
+    if (diff != 0 && options->out_dir) {
+        snprintf(path, sizeof path, "%s/%s.png", options->out_dir, name);
+        host_png_write(path, w, h, rgb);
+        if (golden && diff > 0) {
+            // Highlight the differing pixels in red over a faded copy of the golden image.
+            uint8_t* marked = malloc(w * h * 3);
+            for (int k = 0; k < w * h * 3; k += 3) {
+                bool same = !memcmp(rgb + k, golden + k, 3);
+                marked[k + 0] = same ? 192 + golden[k + 0] / 4 : 255;
+                marked[k + 1] = same ? 192 + golden[k + 1] / 4 : 0;
+                marked[k + 2] = same ? 192 + golden[k + 2] / 4 : 0;
+            }
+            snprintf(path, sizeof path, "%s/%s-diff.png", options->out_dir, name);
+            host_png_write(path, w, h, marked);
+            free(marked);
+        }
+    }
+    free(golden);
+    return diff;
+}
+
+/* A 4x4 checkerboard of 2x2 cells in the frame buffer format. */
+static GBitmap* create_pattern() {
+    GBitmap* bitmap = gbitmap_create_blank(GSize(4, 4), PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+    if (bitmap) {
+        uint8_t* data = gbitmap_get_data(bitmap);
+        uint16_t stride = gbitmap_get_bytes_per_row(bitmap);
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                bool dark = ((x / 2) ^ (y / 2)) & 1;
+#ifdef PBL_COLOR
+                data[y * stride + x] = dark ? GColorBlack.argb : GColorGreen.argb;
+#else
+                if (!dark) data[y * stride + x / 8] |= 1 << (x % 8);
+#endif
+            }
+        }
+    }
+    return bitmap;
+}
+
+static FPath* pack_path(const FPath* path) {
+    FPath* packed = path ? malloc(sizeof(FPath) + FPATH_PACKED_SIZE_MAX(path->size)) : NULL;
+    if (packed) {
+        packed->data = packed + 1;
+        packed->size = fpath_pack(path->data, path->size, packed->data);
+        if (!packed->size) {
+            free(packed);
+            packed = NULL;
+        }
+    }
+    return packed;
+}
+
+static FFont* pack_font(FFont* font) {
+    FFont* packed = font ? malloc(FPATH_PACKED_SIZE_MAX(ffont_size(font))) : NULL;
+    if (packed && !ffont_pack(font, packed)) {
+        free(packed);
+        packed = NULL;
+    }
+    return packed;
+}
+
+static bool load_assets(const char* dir, Assets* assets) {
+    static const struct { uint32_t id; const char* file; } files[] = {
+        { RESOURCE_ID_NARROW_FFONT, "archivo-narrow-regular.ffont" },
+        { RESOURCE_ID_BODY_FPATH,   "body.fpath" },
+        { RESOURCE_ID_HOUR_FPATH,   "hour.fpath" },
+        { RESOURCE_ID_MINUTE_FPATH, "minute.fpath" }
+    };
+    char path[512];
+    for (unsigned k = 0; k < ARRAY_LENGTH(files); ++k) {
+        snprintf(path, sizeof path, "%s/%s", dir, files[k].file);
+        if (!host_resource_register(files[k].id, path)) {
+            return false;
+        }
+    }
+    assets->font = ffont_create_from_resource(RESOURCE_ID_NARROW_FFONT);
+    assets->body = fpath_create_from_resource(RESOURCE_ID_BODY_FPATH);
+    assets->hour = fpath_create_from_resource(RESOURCE_ID_HOUR_FPATH);
+    assets->minute = fpath_create_from_resource(RESOURCE_ID_MINUTE_FPATH);
+    assets->body_lod = assets->body ? fpath_create_lod(assets->body, FPATH_LOD_MAX_LEVELS) : NULL;
+    assets->packed_font = pack_font(assets->font);
+    assets->packed_body = pack_path(assets->body);
+    assets->packed_hour = pack_path(assets->hour);
+    assets->packed_minute = pack_path(assets->minute);
+    assets->atlas = fglyph_atlas_create(8 * 1024);
+    assets->pattern = create_pattern();
+    assets->layers[0] = assets->layers[1] = NULL;
+    return assets->font && assets->body && assets->hour && assets->minute && assets->body_lod &&
+           assets->packed_font && assets->packed_body && assets->packed_hour && assets->packed_minute &&
+           assets->atlas && assets->pattern;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --resources DIR   directory of the test-app resources (default test-app/resources)\n"
+        "  --golden DIR      directory of the golden images (default tools/bench/golden)\n"
+        "  --out DIR         write mismatching frames and diff images here\n"
+        "  --iterations N    frames to time per scene (default 50)\n"
+        "  --update          replace the golden images with the current output\n"
+        "  --kernel NAME     resolve AA fills with this kernel: scalar, sse2, avx2 or neon\n"
+        "  --self-test N     check the resolve kernels against the scalar one on N spans\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+
+    Options options = { "tools/bench/golden", NULL, "test-app/resources", 50, false };
+    for (int k = 1; k < argc; ++k) {
+        if (!strcmp(argv[k], "--resources") && k + 1 < argc) {
+            options.resource_dir = argv[++k];
+        } else if (!strcmp(argv[k], "--golden") && k + 1 < argc) {
+            options.golden_dir = argv[++k];
+        } else if (!strcmp(argv[k], "--out") && k + 1 < argc) {
+            options.out_dir = argv[++k];
+        } else if (!strcmp(argv[k], "--iterations") && k + 1 < argc) {
+            options.iterations = atoi(argv[++k]);
+        } else if (!strcmp(argv[k], "--update")) {
+            options.update = true;
+        } else if (!strcmp(argv[k], "--kernel") && k + 1 < argc) {
+            // 1-bit platforms dither AA fills without a vector kernel.
+            ++k;
+#ifdef PBL_COLOR
+            if (!fctx_host_select_kernel(argv[k])) {
+                fprintf(stderr, "kernel %s is not available\n", argv[k]);
+                return 2;
+            }
+#endif
+        } else if (!strcmp(argv[k], "--self-test") && k + 1 < argc) {
+            ++k;
+            return PBL_IF_COLOR_ELSE(fctx_host_self_test(atoi(argv[k])) ? 1 : 0, 0);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    Assets assets;
+    if (!load_assets(options.resource_dir, &assets)) {
+        return 2;
+    }
+    GContext* gctx = host_gcontext_create();
+    GBitmap* fb = host_gcontext_get_frame_buffer(gctx);
+    int pixels = PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT;
+    uint8_t* rgb = malloc(pixels * 3);
+    int failures = 0;
+
+    static const char* k_modes[] = { "bw", "aa" };
+    for (int mode = 0; mode < 2; ++mode) {
+        for (unsigned s = 0; s < ARRAY_LENGTH(k_scenes); ++s) {
+            char name[64];
+            snprintf(name, sizeof name, "%s-%s-%s", HOST_PLATFORM_NAME, k_modes[mode], k_scenes[s].name);
+
+            host_bitmap_fill(fb, GColorWhite);
+            int fills = render_frame(gctx, (FContextMode)mode, &assets, k_scenes[s].render);
+            host_bitmap_to_rgb(fb, rgb);
+            int diff = check_golden(&options, name, rgb);
+            if (diff != 0) {
+                ++failures;
+            }
+
+            uint64_t start = host_clock_ns();
+            for (int i = 0; i < options.iterations; ++i) {
+                render_frame(gctx, (FContextMode)mode, &assets, k_scenes[s].render);
+            }
+            double frame_ns = options.iterations
+                            ? (double)(host_clock_ns() - start) / options.iterations : 0;
+
+            printf("%-24s %4d fills %10.0f ns/frame %9.0f ns/fill %7.2f ns/px  %s\n",
+                   name, fills, frame_ns, frame_ns / fills, frame_ns / pixels,
+                   options.update ? "updated" : diff == 0 ? "ok" : diff < 0 ? "NO GOLDEN" : "MISMATCH");
+            if (diff > 0) {
+                printf("    %d pixels differ from the golden image\n", diff);
+            }
+        }
+    }
+
+    free(rgb);
+    host_gcontext_destroy(gctx);
+    ffont_destroy(assets.font);
+    fpath_destroy_lod(assets.body_lod);
+    fpath_destroy(assets.body);
+    fpath_destroy(assets.hour);
+    fpath_destroy(assets.minute);
+    ffont_destroy(assets.packed_font);
+    fpath_destroy(assets.packed_body);
+    fpath_destroy(assets.packed_hour);
+    fpath_destroy(assets.packed_minute);
+    fglyph_atlas_destroy(assets.atlas);
+    gbitmap_destroy(assets.pattern);
+    for (unsigned k = 0; k < ARRAY_LENGTH(assets.layers); ++k) {
+        if (assets.layers[k]) {
+            gbitmap_destroy(assets.layers[k]);
+        }
+    }
+    host_resource_unregister_all();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Build the rendering benchmark for every platform and run it, at the default
+# fixed-point shift and at shift 6.  Any arguments are passed on to each
+# benchmark, e.g. --update or --iterations.
+#
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+BUILD=${BUILD_DIR:-$ROOT/build/bench}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -Wno-address-of-packed-member}
+GOLDEN=$ROOT/tools/bench/golden
+
+status=0
+
+# Build and run one configuration: $1 is its build directory, $2 its extra
+# compiler flags and $3 its golden image directory.
+run_config() {
+    dir=$1 flags=$2 golden=$3
+    shift 3
+    mkdir -p "$dir"
+
+    # The static paths drawn by the static scene.
+    BUILD_DIR="$dir" CC="$CC" CFLAGS="$CFLAGS $flags" "$ROOT/tools/flatten/build.sh"
+    "$dir/fctx-flatten" --include fctx.h --offset -90,-90 "$dir/static_paths.c" "$dir/static_paths.h" \
+        static_body="$ROOT/test-app/resources/body.fpath" \
+        static_hour="$ROOT/test-app/resources/hour.fpath" \
+        static_minute="$ROOT/test-app/resources/minute.fpath" > /dev/null
+
+    for platform in aplite basalt chalk diorite emery; do
+        define=PBL_PLATFORM_$(echo $platform | tr '[:lower:]' '[:upper:]')
+        $CC $CFLAGS $flags -std=gnu11 -DFCTX_HOST -D$define \
+            -I"$ROOT/tools/host" -I"$ROOT/include" -I"$dir" \
+            "$ROOT/tools/host/pebble_host.c" "$ROOT"/src/c/*.c "$ROOT/tools/bench/bench.c" "$dir/static_paths.c" \
+            -lz -lm -o "$dir/bench-$platform"
+        "$dir/bench-$platform" \
+            --resources "$ROOT/test-app/resources" \
+            --golden "$golden" \
+            --out "$dir" "$@" || status=1
+    done
+}
+
+run_config "$BUILD" "" "$GOLDEN" "$@"
+
+# Finer coordinates keep more of the precision of rotated and scaled points,
+# which moves antialiased edges by a level here and there, so this
+# configuration has its own golden images.
+echo "== FIXED_POINT_SHIFT=6 =="
+run_config "$BUILD/shift6" "-DFCTX_WIDE_MATH -DFIXED_POINT_SHIFT=6" "$GOLDEN/shift6" "$@"
+exit $status
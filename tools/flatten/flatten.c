@@ -0,0 +1,184 @@
+
+// -----------------------------------------------------------------------------
+// Static path generator.
+//
+// Flattens .fpath resources, as fctx_flatten_commands does at a scale of one,
+// and writes them as FStaticPath constants in a C source file and header, to
+// be compiled into an app and drawn with fctx_draw_static_path.
+// -----------------------------------------------------------------------------
+
+#include "pebble_host.h"
+#include "fctx.h"
+#include "fpath.h"
+#include <ctype.h>
+
+#define RESOURCE_ID_INPUT 1
+
+typedef struct Input {
+    const char* name;
+    const char* path;
+} Input;
+
+static bool is_identifier(const char* s) {
+    if (!*s || isdigit((unsigned char)*s)) {
+        return false;
+    }
+    for (; *s; ++s) {
+        if (!isalnum((unsigned char)*s) && *s != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Flatten one path resource into flat.  Returns false with a message on failure. */
+static bool flatten(FContext* fctx, const char* in, FPoint offset, FFlatPath* flat) {
+    if (!host_resource_register(RESOURCE_ID_INPUT, in)) {
+        fprintf(stderr, "%s: can not read\n", in);
+        return false;
+    }
+    FPath* path = fpath_create_from_resource(RESOURCE_ID_INPUT);
+    bool ok = path && fctx_path_validate(path->data, path->size);
+    if (!ok) {
+        fprintf(stderr, "%s: not a valid path\n", in);
+    } else if (!fctx_flatten_commands(fctx, flat, offset, path->data, path->size)) {
+        fprintf(stderr, "%s: out of memory\n", in);
+        ok = false;
+    }
+    fpath_destroy(path);
+    host_resource_unregister_all();
+    return ok;
+}
+
+/* Whether every point fits a fixed16_t, with INT16_MIN kept for breaks. */
+static bool fits_fixed16(const FFlatPath* flat) {
+    return flat->count == 0 ||
+        (flat->min.x > FIXED16_TO_FIXED(INT16_MIN) && flat->max.x <= FIXED16_TO_FIXED(INT16_MAX) &&
+         flat->min.y >= FIXED16_TO_FIXED(INT16_MIN) && flat->max.y <= FIXED16_TO_FIXED(INT16_MAX));
+}
+
+static void write_path(FILE* f, const char* name, const char* in, const FFlatPath* flat) {
+    fprintf(f, "\n// %s\n", in);
+    if (!flat->count) {
+        // C has no empty arrays.
+        fprintf(f, "const FStaticPath %s = { 0, NULL, { 0, 0 }, { -1, -1 } };\n", name);
+        return;
+    }
+    fprintf(f, "static const FPoint16 s_%s_points[] = {", name);
+    for (uint16_t k = 0; k < flat->count; ++k) {
+        const FPoint* p = flat->points + k;
+        fprintf(f, (k % 6) ? " " : "\n    ");
+        if (p->x == FFLAT_PATH_BREAK) {
+            fprintf(f, "{ FSTATIC_PATH_BREAK, 0 },");
+        } else {
+            fprintf(f, "{ %d, %d },", FIXED_TO_FIXED16(p->x), FIXED_TO_FIXED16(p->y));
+        }
+    }
+    fprintf(f, "\n};\n\n");
+    fprintf(f, "const FStaticPath %s = {\n", name);
+    fprintf(f, "    %u, s_%s_points,\n", flat->count, name);
+    fprintf(f, "    { %d, %d }, { %d, %d }\n",
+            FIXED_TO_FIXED16(flat->min.x), FIXED_TO_FIXED16(flat->min.y),
+            FIXED_TO_FIXED16(flat->max.x), FIXED_TO_FIXED16(flat->max.y));
+    fprintf(f, "};\n");
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [--include HEADER] [--offset X,Y] OUT.c OUT.h NAME=IN.fpath ...\n"
+        "  Writes each path as the FStaticPath constant NAME.  The generated\n"
+        "  header includes HEADER, by default pebble-fctx/fctx.h.  The offset,\n"
+        "  in pixels, is added to every point, e.g. to move a pivot to the origin.\n",
+        argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* include = "pebble-fctx/fctx.h";
+    FPoint offset = FPointZero;
+    int k = 1;
+    while (k + 1 < argc && !strncmp(argv[k], "--", 2)) {
+        int x, y;
+        if (!strcmp(argv[k], "--include")) {
+            include = argv[k + 1];
+        } else if (!strcmp(argv[k], "--offset") && sscanf(argv[k + 1], "%d,%d", &x, &y) == 2) {
+            offset = FPointI(x, y);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        k += 2;
+    }
+    if (argc - k < 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* out_c = argv[k++];
+    const char* out_h = argv[k++];
+    int count = argc - k;
+    Input* inputs = calloc(count, sizeof(Input));
+    for (int i = 0; i < count; ++i) {
+        char* arg = argv[k + i];
+        char* eq = strchr(arg, '=');
+        if (!eq) {
+            usage(argv[0]);
+            return 2;
+        }
+        *eq = '\0';
+        inputs[i].name = arg;
+        inputs[i].path = eq + 1;
+        if (!is_identifier(inputs[i].name)) {
+            fprintf(stderr, "%s: not a C identifier\n", inputs[i].name);
+            return 2;
+        }
+    }
+
+    // Flatten through a context over a 1x1 bitmap, at a scale of one.
+    GBitmap* bitmap = gbitmap_create_blank(GSize(1, 1), PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+    FContext fctx;
+    if (!fctx_init_context_bitmap(&fctx, bitmap, FContextModeBW)) {
+        return 1;
+    }
+
+    FILE* fc = fopen(out_c, "w");
+    FILE* fh = fopen(out_h, "w");
+    if (!fc || !fh) {
+        fprintf(stderr, "%s: can not write\n", fc ? out_h : out_c);
+        return 1;
+    }
+    const char* header = strrchr(out_h, '/');
+    header = header ? header + 1 : out_h;
+    fprintf(fh, "// Generated by fctx-flatten.  Do not edit.\n\n#pragma once\n#include <%s>\n\n", include);
+    fprintf(fc, "// Generated by fctx-flatten.  Do not edit.\n\n#include \"%s\"\n", header);
+
+    int status = 0;
+    for (int i = 0; i < count && !status; ++i) {
+        FFlatPath flat;
+        fflat_path_init(&flat);
+        if (!flatten(&fctx, inputs[i].path, offset, &flat)) {
+            status = 1;
+        } else if (!fits_fixed16(&flat)) {
+            fprintf(stderr, "%s: coordinates out of range\n", inputs[i].path);
+            status = 1;
+        } else {
+            fprintf(fh, "extern const FStaticPath %s;\n", inputs[i].name);
+            write_path(fc, inputs[i].name, inputs[i].path, &flat);
+            printf("%s: %u points, %zu bytes\n", inputs[i].name, flat.count, flat.count * sizeof(FPoint16));
+        }
+        fflat_path_destroy(&flat);
+    }
+
+    bool ok = fclose(fc) == 0;
+    ok = fclose(fh) == 0 && ok;
+    if (!ok && !status) {
+        fprintf(stderr, "%s: can not write\n", out_c);
+        status = 1;
+    }
+    if (status) {
+        remove(out_c);
+        remove(out_h);
+    }
+    fctx_deinit_context(&fctx);
+    gbitmap_destroy(bitmap);
+    free(inputs);
+    return status;
+}
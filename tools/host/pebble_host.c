@@ -0,0 +1,480 @@
+
+#include "pebble_host.h"
+#include <math.h>
+#include <stdarg.h>
+#include <zlib.h>
+
+// --------------------------------------------------------------------------
+// Bitmaps and graphics contexts.
+// --------------------------------------------------------------------------
+
+struct GBitmap {
+    GSize size;
+    GBitmapFormat format;
+    uint16_t bytes_per_row;
+    uint8_t* data;
+    int16_t* row_min_x;
+    int16_t* row_max_x;
+};
+
+struct GContext {
+    GBitmap* frame_buffer;
+};
+
+GBitmap* gbitmap_create_blank(GSize size, GBitmapFormat format) {
+
+    if (format != GBitmapFormat1Bit && format != GBitmapFormat8Bit && format != GBitmapFormat8BitCircular) {
+        return NULL;
+    }
+    GBitmap* bitmap = calloc(1, sizeof(GBitmap));
+    if (!bitmap) {
+        return NULL;
+    }
+    bitmap->size = size;
+    bitmap->format = format;
+    // 1-bit rows are padded to a whole number of 32-bit words, as on the watch.
+    bitmap->bytes_per_row = (format == GBitmapFormat1Bit) ? ((size.w + 31) / 32) * 4 : size.w;
+    bitmap->data = calloc(size.h, bitmap->bytes_per_row);
+    bitmap->row_min_x = malloc(size.h * sizeof(int16_t));
+    bitmap->row_max_x = malloc(size.h * sizeof(int16_t));
+    if (!bitmap->data || !bitmap->row_min_x || !bitmap->row_max_x) {
+        gbitmap_destroy(bitmap);
+        return NULL;
+    }
+
+    for (int16_t y = 0; y < size.h; ++y) {
+        int16_t inset = 0;
+        if (format == GBitmapFormat8BitCircular) {
+            double r = size.w / 2.0;
+            double dy = y + 0.5 - size.h / 2.0;
+            double half = (dy * dy < r * r) ? sqrt(r * r - dy * dy) : 0;
+            inset = (int16_t)(r - half);
+        }
+        bitmap->row_min_x[y] = inset;
+        bitmap->row_max_x[y] = size.w - 1 - inset;
+    }
+    return bitmap;
+}
+
+void gbitmap_destroy(GBitmap* bitmap) {
+    if (bitmap) {
+        free(bitmap->data);
+        free(bitmap->row_min_x);
+        free(bitmap->row_max_x);
+        free(bitmap);
+    }
+}
+
+GRect gbitmap_get_bounds(const GBitmap* bitmap) {
+    return GRect(0, 0, bitmap->size.w, bitmap->size.h);
+}
+
+uint8_t* gbitmap_get_data(const GBitmap* bitmap) {
+    return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap* bitmap) {
+    return bitmap->bytes_per_row;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap* bitmap) {
+    return bitmap->format;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap* bitmap, uint16_t y) {
+    GBitmapDataRowInfo info;
+    info.data = bitmap->data + y * bitmap->bytes_per_row;
+    info.min_x = bitmap->row_min_x[y];
+    info.max_x = bitmap->row_max_x[y];
+    return info;
+}
+
+GContext* host_gcontext_create(void) {
+    GContext* ctx = malloc(sizeof(GContext));
+    if (ctx) {
+        ctx->frame_buffer = gbitmap_create_blank(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), HOST_FRAMEBUFFER_FORMAT);
+        if (!ctx->frame_buffer) {
+            free(ctx);
+            return NULL;
+        }
+        host_bitmap_fill(ctx->frame_buffer, GColorWhite);
+    }
+    return ctx;
+}
+
+void host_gcontext_destroy(GContext* ctx) {
+    if (ctx) {
+        gbitmap_destroy(ctx->frame_buffer);
+        free(ctx);
+    }
+}
+
+GBitmap* host_gcontext_get_frame_buffer(GContext* ctx) {
+    return ctx->frame_buffer;
+}
+
+GBitmap* graphics_capture_frame_buffer(GContext* ctx) {
+    return ctx->frame_buffer;
+}
+
+bool graphics_release_frame_buffer(GContext* ctx, GBitmap* buffer) {
+    return buffer == ctx->frame_buffer;
+}
+
+void host_bitmap_fill(GBitmap* bitmap, GColor color) {
+    uint8_t value = color.argb;
+    if (bitmap->format == GBitmapFormat1Bit) {
+        value = gcolor_equal(color, GColorBlack) ? 0x00 : 0xff;
+    }
+    memset(bitmap->data, value, bitmap->size.h * bitmap->bytes_per_row);
+}
+
+void host_bitmap_to_rgb(const GBitmap* bitmap, uint8_t* rgb) {
+    for (int16_t y = 0; y < bitmap->size.h; ++y) {
+        GBitmapDataRowInfo row = gbitmap_get_data_row_info(bitmap, y);
+        for (int16_t x = 0; x < bitmap->size.w; ++x, rgb += 3) {
+            if (x < row.min_x || x > row.max_x) {
+                rgb[0] = rgb[1] = rgb[2] = 0xff;
+            } else if (bitmap->format == GBitmapFormat1Bit) {
+                uint8_t v = (row.data[x / 8] & (1 << (x % 8))) ? 0xff : 0x00;
+                rgb[0] = rgb[1] = rgb[2] = v;
+            } else {
+                GColor8 c = { .argb = row.data[x] };
+                rgb[0] = c.r * 85;
+                rgb[1] = c.g * 85;
+                rgb[2] = c.b * 85;
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// Math and logging.
+// --------------------------------------------------------------------------
+
+int32_t sin_lookup(int32_t angle) {
+    return (int32_t)lround(sin(angle * 2.0 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+    return (int32_t)lround(cos(angle * 2.0 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+void host_log(uint8_t level, const char* file, int line, const char* fmt, ...) {
+    const char* name = (level <= APP_LOG_LEVEL_ERROR) ? "E"
+                     : (level <= APP_LOG_LEVEL_WARNING) ? "W"
+                     : (level <= APP_LOG_LEVEL_INFO) ? "I" : "D";
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "[%s] %s:%d> ", name, file, line);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// --------------------------------------------------------------------------
+// Resources.
+// --------------------------------------------------------------------------
+
+struct HostResource {
+    uint32_t id;
+    size_t size;
+    uint8_t* data;
+};
+
+static struct HostResource* s_resources = NULL;
+static size_t s_resource_count = 0;
+
+bool host_resource_register(uint32_t resource_id, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "cannot open %s", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    bool ok = data && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok) {
+        free(data);
+        return false;
+    }
+
+    struct HostResource* resources = realloc(s_resources, (s_resource_count + 1) * sizeof(struct HostResource));
+    if (!resources) {
+        free(data);
+        return false;
+    }
+    s_resources = resources;
+    s_resources[s_resource_count].id = resource_id;
+    s_resources[s_resource_count].size = size;
+    s_resources[s_resource_count].data = data;
+    ++s_resource_count;
+    return true;
+}
+
+void host_resource_unregister_all(void) {
+    for (size_t k = 0; k < s_resource_count; ++k) {
+        free(s_resources[k].data);
+    }
+    free(s_resources);
+    s_resources = NULL;
+    s_resource_count = 0;
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+    for (size_t k = 0; k < s_resource_count; ++k) {
+        if (s_resources[k].id == resource_id) {
+            return s_resources + k;
+        }
+    }
+    APP_LOG(APP_LOG_LEVEL_ERROR, "no resource %u", (unsigned)resource_id);
+    return NULL;
+}
+
+size_t resource_size(ResHandle h) {
+    return h ? h->size : 0;
+}
+
+size_t resource_load(ResHandle h, uint8_t* buffer, size_t max_length) {
+    return resource_load_byte_range(h, 0, buffer, max_length);
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t* buffer, size_t num_bytes) {
+    if (!h || start_offset >= h->size) {
+        return 0;
+    }
+    if (num_bytes > h->size - start_offset) {
+        num_bytes = h->size - start_offset;
+    }
+    memcpy(buffer, h->data + start_offset, num_bytes);
+    return num_bytes;
+}
+
+// --------------------------------------------------------------------------
+// Time, memory and timers.
+// --------------------------------------------------------------------------
+
+uint64_t host_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint16_t time_ms(time_t* tloc, uint16_t* out_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint16_t ms = ts.tv_nsec / 1000000;
+    if (tloc) *tloc = ts.tv_sec;
+    if (out_ms) *out_ms = ms;
+    return ms;
+}
+
+static size_t s_heap_bytes_free = 1 << 20;
+
+void host_set_heap_bytes_free(size_t bytes) {
+    s_heap_bytes_free = bytes;
+}
+
+size_t heap_bytes_free(void) {
+    return s_heap_bytes_free;
+}
+
+struct AppTimer {
+    AppTimerCallback callback;
+    void* data;
+    uint64_t due;
+    AppTimer* next;
+};
+
+static AppTimer* s_timers = NULL;
+static uint64_t s_timer_clock = 0;
+
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* callback_data) {
+    AppTimer* timer = malloc(sizeof(AppTimer));
+    if (timer) {
+        timer->callback = callback;
+        timer->data = callback_data;
+        timer->due = s_timer_clock + timeout_ms;
+        // Keep the list sorted by expiry; equal expiries run in order of registration.
+        AppTimer** link = &s_timers;
+        while (*link && (*link)->due <= timer->due) {
+            link = &(*link)->next;
+        }
+        timer->next = *link;
+        *link = timer;
+    }
+    return timer;
+}
+
+void app_timer_cancel(AppTimer* timer) {
+    for (AppTimer** link = &s_timers; *link; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            free(timer);
+            return;
+        }
+    }
+}
+
+bool host_app_timer_run_next(void) {
+    AppTimer* timer = s_timers;
+    if (!timer) {
+        return false;
+    }
+    s_timers = timer->next;
+    s_timer_clock = timer->due;
+    timer->callback(timer->data);
+    free(timer);
+    return true;
+}
+
+int host_app_timer_run_pending(void) {
+    int count = 0;
+    while (host_app_timer_run_next()) {
+        ++count;
+    }
+    return count;
+}
+
+// --------------------------------------------------------------------------
+// PNG images.
+// --------------------------------------------------------------------------
+
+static void png_put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t png_get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool png_write_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t length) {
+    uint8_t header[8];
+    png_put_u32(header, length);
+    memcpy(header + 4, type, 4);
+    uint32_t crc = crc32(0, header + 4, 4);
+    crc = crc32(crc, data, length);
+    uint8_t trailer[4];
+    png_put_u32(trailer, crc);
+    return fwrite(header, 1, 8, file) == 8
+        && fwrite(data, 1, length, file) == length
+        && fwrite(trailer, 1, 4, file) == 4;
+}
+
+static const uint8_t k_png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+bool host_png_write(const char* path, int width, int height, const uint8_t* rgb) {
+
+    size_t raw_size = (size_t)height * (1 + width * 3);
+    uint8_t* raw = malloc(raw_size);
+    uLongf packed_size = compressBound(raw_size);
+    uint8_t* packed = malloc(packed_size);
+    FILE* file = fopen(path, "wb");
+    bool ok = raw && packed && file;
+
+    if (ok) {
+        // Every row uses filter type 0, which is all that host_png_read decodes.
+        uint8_t* p = raw;
+        for (int y = 0; y < height; ++y) {
+            *p++ = 0;
+            memcpy(p, rgb + (size_t)y * width * 3, width * 3);
+            p += width * 3;
+        }
+        ok = compress2(packed, &packed_size, raw, raw_size, 9) == Z_OK;
+    }
+    if (ok) {
+        uint8_t ihdr[13];
+        png_put_u32(ihdr, width);
+        png_put_u32(ihdr + 4, height);
+        ihdr[8] = 8;  // bit depth
+        ihdr[9] = 2;  // color type RGB
+        ihdr[10] = 0; // compression
+        ihdr[11] = 0; // filter
+        ihdr[12] = 0; // interlace
+        ok = fwrite(k_png_signature, 1, 8, file) == 8
+          && png_write_chunk(file, "IHDR", ihdr, sizeof ihdr)
+          && png_write_chunk(file, "IDAT", packed, packed_size)
+          && png_write_chunk(file, "IEND", NULL, 0);
+    }
+
+    if (file) fclose(file);
+    free(packed);
+    free(raw);
+    return ok;
+}
+
+uint8_t* host_png_read(const char* path, int* width, int* height) {
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    bool ok = data && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    uint8_t* idat = NULL;
+    size_t idat_size = 0;
+    uint8_t* rgb = NULL;
+    int w = 0, h = 0;
+
+    ok = ok && size >= 8 && memcmp(data, k_png_signature, 8) == 0;
+    for (long pos = 8; ok && pos + 12 <= size; ) {
+        uint32_t length = png_get_u32(data + pos);
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* chunk = data + pos + 8;
+        if (pos + 12 + (long)length > size) {
+            ok = false;
+        } else if (memcmp(type, "IHDR", 4) == 0) {
+            w = png_get_u32(chunk);
+            h = png_get_u32(chunk + 4);
+            ok = length == 13 && chunk[8] == 8 && chunk[9] == 2 && chunk[12] == 0;
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            uint8_t* grown = realloc(idat, idat_size + length);
+            ok = grown != NULL;
+            if (ok) {
+                idat = grown;
+                memcpy(idat + idat_size, chunk, length);
+                idat_size += length;
+            }
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + length;
+    }
+
+    if (ok && w > 0 && h > 0) {
+        uLongf raw_size = (uLongf)h * (1 + w * 3);
+        uint8_t* raw = malloc(raw_size);
+        rgb = malloc((size_t)w * h * 3);
+        ok = raw && rgb && uncompress(raw, &raw_size, idat, idat_size) == Z_OK
+          && raw_size == (uLongf)h * (1 + w * 3);
+        for (int y = 0; ok && y < h; ++y) {
+            const uint8_t* row = raw + (size_t)y * (1 + w * 3);
+            ok = row[0] == 0;
+            memcpy(rgb + (size_t)y * w * 3, row + 1, w * 3);
+        }
+        free(raw);
+    } else {
+        ok = false;
+    }
+
+    free(idat);
+    free(data);
+    if (!ok) {
+        free(rgb);
+        return NULL;
+    }
+    *width = w;
+    *height = h;
+    return rgb;
+}
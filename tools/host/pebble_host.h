@@ -0,0 +1,69 @@
+#pragma once
+#include "pebble.h"
+
+// -----------------------------------------------------------------------------
+// Host-only extensions to the Pebble SDK shim.
+// -----------------------------------------------------------------------------
+
+#if defined(PBL_ROUND)
+#define HOST_FRAMEBUFFER_FORMAT GBitmapFormat8BitCircular
+#elif defined(PBL_COLOR)
+#define HOST_FRAMEBUFFER_FORMAT GBitmapFormat8Bit
+#else
+#define HOST_FRAMEBUFFER_FORMAT GBitmapFormat1Bit
+#endif
+
+/**
+ * Create a frame buffer of the platform's geometry and format, and a graphics
+ * context that renders into it.
+ */
+GContext* host_gcontext_create(void);
+void host_gcontext_destroy(GContext* ctx);
+GBitmap* host_gcontext_get_frame_buffer(GContext* ctx);
+
+/**
+ * Fill a bitmap with a color, including the area outside a round display.
+ */
+void host_bitmap_fill(GBitmap* bitmap, GColor color);
+
+/**
+ * Register a file as the resource with the given id.  The file is read into
+ * memory when it is registered.
+ */
+bool host_resource_register(uint32_t resource_id, const char* path);
+void host_resource_unregister_all(void);
+
+/**
+ * Limit the value returned by heap_bytes_free().
+ */
+void host_set_heap_bytes_free(size_t bytes);
+
+/**
+ * Run the callback of the app timer that expires first.
+ * @return false if no timers are registered.
+ */
+bool host_app_timer_run_next(void);
+
+/**
+ * Run the callbacks of all registered app timers, in order of expiry.
+ * @return the number of callbacks run.
+ */
+int host_app_timer_run_pending(void);
+
+/**
+ * Nanoseconds from a monotonic clock.
+ */
+uint64_t host_clock_ns(void);
+
+/**
+ * Convert a bitmap to 8-bit RGB, 3 bytes per pixel.  Pixels outside the
+ * visible area of a round bitmap are converted as white.
+ */
+void host_bitmap_to_rgb(const GBitmap* bitmap, uint8_t* rgb);
+
+/**
+ * Write or read an 8-bit RGB PNG image.  host_png_read only needs to decode
+ * the images written by host_png_write.
+ */
+bool host_png_write(const char* path, int width, int height, const uint8_t* rgb);
+uint8_t* host_png_read(const char* path, int* width, int* height);
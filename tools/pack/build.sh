@@ -0,0 +1,15 @@
+#!/bin/sh
+#
+# Build the resource packer, as build/pack/fctx-pack.
+#
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+BUILD=${BUILD_DIR:-$ROOT/build/pack}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -Wno-address-of-packed-member}
+mkdir -p "$BUILD"
+
+$CC $CFLAGS -std=gnu11 -DFCTX_HOST -DPBL_PLATFORM_BASALT \
+    -I"$ROOT/tools/host" -I"$ROOT/include" \
+    "$ROOT/tools/host/pebble_host.c" "$ROOT"/src/c/*.c "$ROOT/tools/pack/pack.c" \
+    -lz -lm -o "$BUILD/fctx-pack"
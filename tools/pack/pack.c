@@ -0,0 +1,84 @@
+
+// -----------------------------------------------------------------------------
+// Path and font resource packer.
+//
+// Converts .fpath and .ffont resources built by fctx-compiler to packed path
+// data (see FCTX_PACKED_PATH_MAGIC in fctx.h), which the library draws
+// exactly as it draws the original.
+// -----------------------------------------------------------------------------
+
+#include "pebble_host.h"
+#include "fctx.h"
+#include "ffont.h"
+#include "fpath.h"
+
+#define RESOURCE_ID_INPUT 1
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && !strcmp(s + n - m, suffix);
+}
+
+static bool write_file(const char* path, const void* data, size_t size) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+/* Pack one resource.  Returns the packed size, or 0 on failure. */
+static size_t pack(const char* in, const char* out, size_t* in_size) {
+    if (!host_resource_register(RESOURCE_ID_INPUT, in)) {
+        fprintf(stderr, "%s: can not read\n", in);
+        return 0;
+    }
+    size_t size = 0;
+    if (has_suffix(in, ".ffont")) {
+        FFont* font = ffont_create_from_resource(RESOURCE_ID_INPUT);
+        *in_size = ffont_size(font);
+        void* packed = malloc(FPATH_PACKED_SIZE_MAX(*in_size));
+        size = ffont_pack(font, packed);
+        if (!size) {
+            fprintf(stderr, "%s: outlines too large\n", in);
+        } else if (!write_file(out, packed, size)) {
+            fprintf(stderr, "%s: can not write\n", out);
+            size = 0;
+        }
+        free(packed);
+        ffont_destroy(font);
+    } else {
+        FPath* path = fpath_create_from_resource(RESOURCE_ID_INPUT);
+        *in_size = path->size;
+        void* packed = malloc(FPATH_PACKED_SIZE_MAX(path->size));
+        size = fpath_pack(path->data, path->size, packed);
+        if (!size) {
+            fprintf(stderr, "%s: path too large\n", in);
+        } else if (!write_file(out, packed, size)) {
+            fprintf(stderr, "%s: can not write\n", out);
+            size = 0;
+        }
+        free(packed);
+        fpath_destroy(path);
+    }
+    host_resource_unregister_all();
+    return size;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3 || argv[1][0] == '-') {
+        fprintf(stderr,
+            "usage: %s IN OUT\n"
+            "  Packs an .fpath resource, or an .ffont resource if IN ends in .ffont.\n",
+            argv[0]);
+        return 2;
+    }
+    size_t in_size = 0;
+    size_t size = pack(argv[1], argv[2], &in_size);
+    if (!size) {
+        return 1;
+    }
+    printf("%s: %zu -> %zu bytes\n", argv[2], in_size, size);
+    return 0;
+}
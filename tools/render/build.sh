@@ -0,0 +1,18 @@
+#!/bin/sh
+#
+# Build the offline renderer for every platform, as build/render/fctx-render-<platform>.
+#
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+BUILD=${BUILD_DIR:-$ROOT/build/render}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -Wno-address-of-packed-member}
+mkdir -p "$BUILD"
+
+for platform in ${PLATFORMS:-aplite basalt chalk diorite emery}; do
+    define=PBL_PLATFORM_$(echo $platform | tr '[:lower:]' '[:upper:]')
+    $CC $CFLAGS -std=gnu11 -DFCTX_HOST -D$define \
+        -I"$ROOT/tools/host" -I"$ROOT/include" \
+        "$ROOT/tools/host/pebble_host.c" "$ROOT"/src/c/*.c "$ROOT/tools/render/render.c" \
+        -lz -lm -o "$BUILD/fctx-render-$platform"
+done
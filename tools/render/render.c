@@ -0,0 +1,506 @@
+
+// -----------------------------------------------------------------------------
+// Offline batch renderer.
+//
+// Renders a scripted scene to a sequence of PNG or raw frame buffer images,
+// one frame per time step, spreading the frames across worker processes.
+// Each worker has its own FContext and frame buffer.
+// -----------------------------------------------------------------------------
+
+#include "pebble_host.h"
+#include "fctx.h"
+#include "ffont.h"
+#include "fpath.h"
+#include "fresource.h"
+#include <ctype.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_RESOURCES 32
+#define MAX_OPS 256
+#define MAX_NAME 32
+#define MAX_TEXT 64
+
+// --------------------------------------------------------------------------
+// Scene scripts.
+//
+// A scene is a line-oriented script:
+//
+//   font NAME FILE              load an .ffont resource; FILE is the rest of the line
+//   path NAME FILE              load an .fpath resource; FILE is the rest of the line
+//   start YYYY-MM-DD HH:MM      time of the first frame
+//   frames COUNT [STEP]         render COUNT frames, STEP seconds apart
+//   mode aa|bw                  rendering mode on color platforms
+//   background COLOR            frame buffer color before drawing
+//   fill COLOR ... end          one fill, drawn with COLOR
+//   scale FROM TO               transform scale
+//   offset X Y                  transform offset, in pixels
+//   pivot X Y                   rotation pivot, in path units
+//   rotate ANGLE                degrees, or hour, minute or second
+//   draw NAME                   draw a path
+//   text FONT EM ALIGN ANCHOR F draw strftime format F in a font
+//
+// Coordinates may be written relative to the display, e.g. "cx+5" or "h-20",
+// where cx, cy, w and h are the center and size of the display.  Colors are
+// named, e.g. "darkgray", or written as "#RRGGBB".  A "#" at the start of a
+// line, or between spaces (or a space and the end of the line), starts a
+// comment.
+// --------------------------------------------------------------------------
+
+typedef enum {
+    OpBegin,
+    OpEnd,
+    OpScale,
+    OpOffset,
+    OpPivot,
+    OpRotate,
+    OpDraw,
+    OpText
+} OpCode;
+
+typedef enum {
+    AngleFixed,
+    AngleHour,
+    AngleMinute,
+    AngleSecond
+} AngleSource;
+
+typedef struct Op {
+    OpCode code;
+    GColor color;
+    FPoint point;
+    AngleSource angle_source;
+    int32_t angle;
+    int16_t resource;
+    int16_t em_height;
+    GTextAlignment alignment;
+    FTextAnchor anchor;
+    char format[MAX_TEXT];
+} Op;
+
+typedef struct Resource {
+    char name[MAX_NAME];
+    bool is_font;
+    FResourceMap* map;
+    FFont* font;
+    FPath* path;
+} Resource;
+
+typedef struct Scene {
+    Resource resources[MAX_RESOURCES];
+    int resource_count;
+    Op ops[MAX_OPS];
+    int op_count;
+    time_t start;
+    int frames;
+    int step;
+    bool aa;
+    GColor background;
+} Scene;
+
+static const struct {
+    const char* name;
+    uint8_t argb;
+} k_colors[] = {
+    { "clear", 0x00 }, { "black", 0xC0 }, { "white", 0xFF }, { "darkgray", 0xD5 },
+    { "lightgray", 0xEA }, { "red", 0xF0 }, { "green", 0xCC }, { "blue", 0xC3 },
+    { "yellow", 0xFC }, { "orange", 0xF8 }
+};
+
+static bool parse_color(const char* s, GColor* color) {
+    for (unsigned k = 0; k < ARRAY_LENGTH(k_colors); ++k) {
+        if (!strcmp(s, k_colors[k].name)) {
+            color->argb = k_colors[k].argb;
+            return true;
+        }
+    }
+    if (s[0] == '#' && strlen(s) == 7) {
+        unsigned rgb;
+        if (sscanf(s + 1, "%x", &rgb) == 1) {
+            *color = GColorFromRGB((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Parse a coordinate in pixels, optionally relative to the display. */
+static bool parse_coord(const char* s, fixed_t* value) {
+    double base = 0;
+    if (!strncmp(s, "cx", 2)) { base = PBL_DISPLAY_WIDTH / 2.0; s += 2; }
+    else if (!strncmp(s, "cy", 2)) { base = PBL_DISPLAY_HEIGHT / 2.0; s += 2; }
+    else if (s[0] == 'w') { base = PBL_DISPLAY_WIDTH; s += 1; }
+    else if (s[0] == 'h') { base = PBL_DISPLAY_HEIGHT; s += 1; }
+    double offset = 0;
+    if (*s) {
+        char* end;
+        offset = strtod(s, &end);
+        if (*end) {
+            return false;
+        }
+    }
+    *value = (fixed_t)((base + offset) * FIXED_POINT_SCALE);
+    return true;
+}
+
+/* Cut a line at its comment, if it has one.  A "#" that is the first word of
+ * the line, or a word of its own, starts a comment; any other is part of a
+ * word, such as a color. */
+static void strip_comment(char* line) {
+    for (char* p = strchr(line, '#'); p; p = strchr(p + 1, '#')) {
+        bool starts_word = (p == line) || isspace((unsigned char)p[-1]);
+        bool first_word = starts_word && (p == line + strspn(line, " \t"));
+        bool own_word = starts_word && (!p[1] || isspace((unsigned char)p[1]));
+        if (first_word || own_word) {
+            *p = 0;
+            return;
+        }
+    }
+}
+
+/* Cut the line ending, and any spaces before it, from a word. */
+static char* trim_end(char* word) {
+    size_t length = strlen(word);
+    while (length && isspace((unsigned char)word[length - 1])) {
+        word[--length] = 0;
+    }
+    return word;
+}
+
+/* Return the text of a line after its first count words. */
+static char* skip_words(char* line, int count) {
+    while (count-- > 0) {
+        while (isspace((unsigned char)*line)) ++line;
+        while (*line && !isspace((unsigned char)*line)) ++line;
+    }
+    while (isspace((unsigned char)*line)) ++line;
+    return line;
+}
+
+static int find_resource(Scene* scene, const char* name, bool is_font) {
+    for (int k = 0; k < scene->resource_count; ++k) {
+        if (!strcmp(scene->resources[k].name, name) && scene->resources[k].is_font == is_font) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static bool load_resource(Scene* scene, const char* dir, const char* name, const char* file, bool is_font) {
+    size_t name_length = strlen(name);
+    if (scene->resource_count == MAX_RESOURCES || name_length >= sizeof scene->resources[0].name) {
+        return false;
+    }
+    char path[1024];
+    if (file[0] == '/') {
+        snprintf(path, sizeof path, "%s", file);
+    } else {
+        snprintf(path, sizeof path, "%s/%s", dir, file);
+    }
+    // The file is mapped rather than read, so the workers share its pages.
+    FResourceMap* map = fresource_map_file(path, is_font ? FResourceTypeFont : FResourceTypePath);
+    if (!map) {
+        return false;
+    }
+    Resource* r = scene->resources + scene->resource_count++;
+    memcpy(r->name, name, name_length + 1);
+    r->is_font = is_font;
+    r->map = map;
+    r->font = fresource_map_font(map);
+    r->path = fresource_map_path(map);
+    return true;
+}
+
+static bool parse_scene(const char* filename, Scene* scene) {
+
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    char dir[1024];
+    snprintf(dir, sizeof dir, "%s", filename);
+    char* slash = strrchr(dir, '/');
+    if (slash) *slash = 0; else strcpy(dir, ".");
+
+    memset(scene, 0, sizeof(Scene));
+    scene->frames = 1;
+    scene->step = 60;
+    scene->aa = true;
+    scene->background = GColorWhite;
+
+    char line[1024];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof line, file)) {
+        ++line_number;
+        strip_comment(line);
+
+        char w[6][MAX_TEXT] = { { 0 } };
+        int n = sscanf(line, "%63s %63s %63s %63s %63s %63s", w[0], w[1], w[2], w[3], w[4], w[5]);
+        if (n <= 0) {
+            continue;
+        }
+        Op* op = scene->ops + scene->op_count;
+        if (scene->op_count == MAX_OPS) {
+            ok = false;
+        } else if ((!strcmp(w[0], "font") || !strcmp(w[0], "path")) && n >= 3) {
+            // The file is the rest of the line, so it may be longer than a word.
+            ok = load_resource(scene, dir, w[1], trim_end(skip_words(line, 2)), w[0][0] == 'f');
+        } else if (!strcmp(w[0], "start") && n == 3) {
+            struct tm tm = { 0 };
+            ok = sscanf(w[1], "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) == 3
+              && sscanf(w[2], "%d:%d", &tm.tm_hour, &tm.tm_min) == 2;
+            tm.tm_year -= 1900;
+            tm.tm_mon -= 1;
+            scene->start = timegm(&tm);
+        } else if (!strcmp(w[0], "frames") && n >= 2) {
+            scene->frames = atoi(w[1]);
+            scene->step = (n > 2) ? atoi(w[2]) : 60;
+        } else if (!strcmp(w[0], "mode") && n == 2) {
+            scene->aa = !strcmp(w[1], "aa");
+        } else if (!strcmp(w[0], "background") && n == 2) {
+            ok = parse_color(w[1], &scene->background);
+        } else if (!strcmp(w[0], "fill") && n == 2) {
+            op->code = OpBegin;
+            ok = parse_color(w[1], &op->color);
+            scene->op_count += ok;
+        } else if (!strcmp(w[0], "end") && n == 1) {
+            op->code = OpEnd;
+            ++scene->op_count;
+        } else if (!strcmp(w[0], "scale") && n == 3) {
+            op->code = OpScale;
+            op->point = FPoint(atoi(w[1]), atoi(w[2]));
+            ok = op->point.x > 0 && op->point.y > 0;
+            scene->op_count += ok;
+        } else if ((!strcmp(w[0], "offset") || !strcmp(w[0], "pivot")) && n == 3) {
+            op->code = (w[0][0] == 'o') ? OpOffset : OpPivot;
+            ok = parse_coord(w[1], &op->point.x) && parse_coord(w[2], &op->point.y);
+            scene->op_count += ok;
+        } else if (!strcmp(w[0], "rotate") && n == 2) {
+            op->code = OpRotate;
+            op->angle_source = !strcmp(w[1], "hour") ? AngleHour
+                             : !strcmp(w[1], "minute") ? AngleMinute
+                             : !strcmp(w[1], "second") ? AngleSecond : AngleFixed;
+            op->angle = (int32_t)(atof(w[1]) * TRIG_MAX_ANGLE / 360);
+            ++scene->op_count;
+        } else if (!strcmp(w[0], "draw") && n == 2) {
+            op->code = OpDraw;
+            op->resource = find_resource(scene, w[1], false);
+            ok = op->resource >= 0;
+            scene->op_count += ok;
+        } else if (!strcmp(w[0], "text") && n >= 6) {
+            op->code = OpText;
+            op->resource = find_resource(scene, w[1], true);
+            op->em_height = atoi(w[2]);
+            op->alignment = !strcmp(w[3], "left") ? GTextAlignmentLeft
+                          : !strcmp(w[3], "right") ? GTextAlignmentRight : GTextAlignmentCenter;
+            op->anchor = !strcmp(w[4], "middle") ? FTextAnchorMiddle
+                       : !strcmp(w[4], "top") ? FTextAnchorTop
+                       : !strcmp(w[4], "bottom") ? FTextAnchorBottom : FTextAnchorBaseline;
+            // The format is the rest of the line, after the anchor.
+            const char* format = skip_words(line, 5);
+            size_t length = strcspn(format, "\r\n");
+            if (length < sizeof op->format) {
+                memcpy(op->format, format, length);
+                op->format[length] = 0;
+            }
+            ok = op->resource >= 0 && length < sizeof op->format;
+            scene->op_count += ok;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: cannot parse: %s", filename, line_number, line);
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// --------------------------------------------------------------------------
+// Rendering.
+// --------------------------------------------------------------------------
+
+static int32_t angle_for_time(const Op* op, const struct tm* tm) {
+    switch (op->angle_source) {
+        case AngleHour:
+            return (tm->tm_hour % 12) * TRIG_MAX_ANGLE / 12 + tm->tm_min * TRIG_MAX_ANGLE / (12 * 60);
+        case AngleMinute:
+            return tm->tm_min * TRIG_MAX_ANGLE / 60;
+        case AngleSecond:
+            return tm->tm_sec * TRIG_MAX_ANGLE / 60;
+        default:
+            return op->angle;
+    }
+}
+
+static void render_scene(Scene* scene, GContext* gctx, const struct tm* tm) {
+
+    FContext fctx;
+    fctx_init_context(&fctx, gctx);
+    FFlatPath flat;
+    fflat_path_init(&flat);
+    FPoint pivot = FPointZero;
+    FTransform transform = { FPointZero, 0 };
+
+    for (int k = 0; k < scene->op_count; ++k) {
+        Op* op = scene->ops + k;
+        switch (op->code) {
+            case OpBegin:
+                fctx_begin_fill(&fctx);
+                fctx_set_fill_color(&fctx, op->color);
+                break;
+            case OpEnd:
+                fctx_end_fill(&fctx);
+                break;
+            case OpScale:
+                fctx.transform_scale_from = FPoint(op->point.x, op->point.x);
+                fctx.transform_scale_to = FPoint(op->point.y, op->point.y);
+                break;
+            case OpOffset:
+                transform.offset = op->point;
+                break;
+            case OpPivot:
+                pivot = op->point;
+                break;
+            case OpRotate:
+                transform.rotation = angle_for_time(op, tm);
+                break;
+            case OpDraw: {
+                FPath* path = scene->resources[op->resource].path;
+                fflat_path_clear(&flat);
+                fctx_flatten_commands(&fctx, &flat, FPoint(-pivot.x, -pivot.y), path->data, path->size);
+                fctx_draw_flat_path(&fctx, &flat, &transform);
+                break;
+            }
+            case OpText: {
+                char text[MAX_TEXT];
+                strftime(text, sizeof text, op->format, tm);
+                FContext text_fctx = fctx;
+                fctx_set_text_em_height(&text_fctx, scene->resources[op->resource].font, op->em_height);
+                fflat_path_clear(&flat);
+                fctx_flatten_string(&text_fctx, &flat, text, scene->resources[op->resource].font,
+                                    op->alignment, op->anchor);
+                fctx_draw_flat_path(&fctx, &flat, &transform);
+                break;
+            }
+        }
+    }
+
+    fflat_path_destroy(&flat);
+    fctx_deinit_context(&fctx);
+}
+
+static bool write_frame(GBitmap* fb, const char* out_dir, int frame, bool raw) {
+    char path[1024];
+    snprintf(path, sizeof path, "%s/%s-%05d.%s", out_dir, HOST_PLATFORM_NAME, frame, raw ? "raw" : "png");
+    if (raw) {
+        FILE* file = fopen(path, "wb");
+        size_t size = gbitmap_get_bytes_per_row(fb) * gbitmap_get_bounds(fb).size.h;
+        bool ok = file && fwrite(gbitmap_get_data(fb), 1, size, file) == size;
+        if (file) fclose(file);
+        return ok;
+    }
+    uint8_t rgb[PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT * 3];
+    host_bitmap_to_rgb(fb, rgb);
+    return host_png_write(path, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, rgb);
+}
+
+/* Render every frame whose index is congruent to worker modulo jobs. */
+static int run_worker(Scene* scene, int worker, int jobs, const char* out_dir, bool raw) {
+    GContext* gctx = host_gcontext_create();
+    if (!gctx) {
+        return 1;
+    }
+    GBitmap* fb = host_gcontext_get_frame_buffer(gctx);
+    int failures = 0;
+    for (int frame = worker; frame < scene->frames; frame += jobs) {
+        time_t t = scene->start + (time_t)frame * scene->step;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        host_bitmap_fill(fb, scene->background);
+        render_scene(scene, gctx, &tm);
+        if (!write_frame(fb, out_dir, frame, raw)) {
+            fprintf(stderr, "cannot write frame %d\n", frame);
+            ++failures;
+        }
+    }
+    host_gcontext_destroy(gctx);
+    return failures ? 1 : 0;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [options] SCENE\n"
+        "  --out DIR     directory for the rendered frames (default .)\n"
+        "  --jobs N      number of worker processes (default: one per core)\n"
+        "  --raw         write raw frame buffer bytes instead of PNG\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+
+    const char* out_dir = ".";
+    const char* scene_file = NULL;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bool raw = false;
+    for (int k = 1; k < argc; ++k) {
+        if (!strcmp(argv[k], "--out") && k + 1 < argc) {
+            out_dir = argv[++k];
+        } else if (!strcmp(argv[k], "--jobs") && k + 1 < argc) {
+            jobs = atoi(argv[++k]);
+        } else if (!strcmp(argv[k], "--raw")) {
+            raw = true;
+        } else if (argv[k][0] != '-' && !scene_file) {
+            scene_file = argv[k];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!scene_file) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (jobs < 1) jobs = 1;
+
+    static Scene scene;
+    if (!parse_scene(scene_file, &scene)) {
+        return 2;
+    }
+#ifdef PBL_COLOR
+    fctx_enable_aa(scene.aa);
+#endif
+    mkdir(out_dir, 0777);
+    if (jobs > scene.frames) jobs = scene.frames;
+
+    uint64_t start = host_clock_ns();
+    int status = 0;
+    if (jobs <= 1) {
+        status = run_worker(&scene, 0, 1, out_dir, raw);
+    } else {
+        // The resources are loaded before forking, so the workers share them.
+        for (int worker = 0; worker < jobs; ++worker) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                _exit(run_worker(&scene, worker, jobs, out_dir, raw));
+            } else if (pid < 0) {
+                perror("fork");
+                status = 1;
+            }
+        }
+        int child_status;
+        while (wait(&child_status) > 0) {
+            if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+                status = 1;
+            }
+        }
+    }
+    double seconds = (host_clock_ns() - start) / 1e9;
+    fprintf(stderr, "%s: %d frames in %.2f s with %d workers\n",
+            HOST_PLATFORM_NAME, scene.frames, seconds, jobs);
+    return status;
+}